@@ -33,8 +33,8 @@ Led on_light(9);      // Basic single color LED on pin 9
     Example states available. These can be any string you'd like and
     there is no state size limit.
 */
-constexpr char Off[] = "Off";
-constexpr char On[] = "On";
+STATE(Off);
+STATE(On);
 
 class DigitalSwitch : public StateDriver<DigitalSwitch>
 {
@@ -40,7 +40,9 @@ void loop()
         // data() is the actual information
         // payload() is the raw data (includes address())
         //
-        lutil::managed_data content = res.data();
+        // data() is a view into the response, no copy is made
+        //
+        lutil::data_view content = res.data();
         for (uint16_t i = 0; i < content.size(); i++)
             Serial.print((char)content[i]);
         Serial.print('\n');
@@ -36,7 +36,7 @@ void loop()
     uint8_t data[] = "Hello, World!";
     request.setPayload(
         data,
-        sizeof(data)
+        sizeof(data) - 1 // Skip the null terminator
     );
 
     // Fire it off...
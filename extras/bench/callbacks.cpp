@@ -0,0 +1,115 @@
+/*
+    Host benchmark for Processable callback dispatch: the flat
+    CallbackTable of Delegates against the Map<int, Vec<Callback>>
+    (function pointer + void *) lookup it replaced. ns per event()
+    for 1 to 16 triggers, one callback each, fired round robin.
+
+        g++ -std=c++14 -O2 -DBUILD_LIB -Isrc extras/bench/callbacks.cpp src/lu_process/process.cpp
+*/
+#include <chrono>
+#include <cstdio>
+
+#include "lutil.h"
+#include "lu_process/process.h"
+#include "lu_storage/map.h"
+#include "lu_storage/vector.h"
+
+static const int kEvents = 1 << 24;
+
+static volatile uint32_t s_sink;
+static uint32_t s_count;
+
+static void bump(void *data) { s_count += (uint32_t)(uintptr_t)data; }
+
+/* The previous Processable::event(), as it was */
+class MapDispatch {
+public:
+    void when(int trigger, lutil::ProcessCallback callback, void *data) {
+        if (!_callbacks.contains(trigger))
+            _callbacks.insert(trigger, CallbackList());
+        _callbacks[trigger].push({callback, data});
+    }
+
+    void event(int trigger) {
+        if (_callbacks.contains(trigger)) {
+            auto &cb_vec = _callbacks[trigger];
+            for (size_t i = 0; i < cb_vec.count(); i++)
+                cb_vec[i].callback(cb_vec[i].data);
+        }
+    }
+
+private:
+    struct Callback {
+        lutil::ProcessCallback callback;
+        void *data;
+    };
+    using CallbackList = lutil::Vec<Callback>;
+    lutil::Map<int, CallbackList> _callbacks;
+};
+
+template<typename DISPATCH>
+static double run(DISPATCH &dispatch, int triggers)
+{
+    s_count = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kEvents; i++)
+        dispatch.event(i % triggers);
+    auto end = std::chrono::steady_clock::now();
+
+    s_sink = s_count;
+    return std::chrono::duration<double, std::nano>(end - start).count() / kEvents;
+}
+
+/* CallbackTable under the same event() name */
+struct TableDispatch {
+    void event(int trigger) { table.call(trigger); }
+    lutil::CallbackTable table;
+};
+
+int main()
+{
+    const int counts[] = { 1, 4, 16 };
+
+    printf("%-22s", "ns/event");
+    for (int triggers : counts)
+        printf("%8d trig", triggers);
+    printf("\n");
+
+    int failures = 0;
+    double map_ns[3], table_ns[3], lambda_ns[3];
+    for (int c = 0; c < 3; c++) {
+        int triggers = counts[c];
+
+        MapDispatch map;
+        TableDispatch table;
+        TableDispatch lambdas;
+        for (int t = 0; t < triggers; t++) {
+            map.when(t, bump, (void *)1);
+            table.table.add(t, [] { bump((void *)1); });
+            uint32_t *count = &s_count;
+            lambdas.table.add(t, [count] { *count += 1; });
+        }
+
+        map_ns[c] = run(map, triggers);
+        failures += s_count != (uint32_t)kEvents;
+        table_ns[c] = run(table, triggers);
+        failures += s_count != (uint32_t)kEvents;
+        lambda_ns[c] = run(lambdas, triggers);
+        failures += s_count != (uint32_t)kEvents;
+    }
+
+    printf("%-22s", "Map<int, Vec<fn,data>>");
+    for (double ns : map_ns)
+        printf("%13.2f", ns);
+    printf("\n%-22s", "CallbackTable (fn)");
+    for (double ns : table_ns)
+        printf("%13.2f", ns);
+    printf("\n%-22s", "CallbackTable (lambda)");
+    for (double ns : lambda_ns)
+        printf("%13.2f", ns);
+    printf("\n\nsizeof(ProcessDelegate) = %zu\n", sizeof(lutil::ProcessDelegate));
+
+    if (failures)
+        printf("!! %d runs made the wrong number of calls\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,78 @@
+/*
+    Host benchmark for the 8 bit frame sums in lu_comm/checksum.h,
+    16 B to 64 KB buffers. sum8() is what XBee3 uses.
+
+        g++ -std=c++14 -O2 -DBUILD_LIB -Isrc extras/bench/checksum.cpp
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "lutil.h"
+#include "lu_comm/checksum.h"
+
+namespace checksum = lutil::checksum;
+
+typedef uint8_t (*SumFn)(const uint8_t *, size_t);
+
+static const size_t kBytes = 1 << 28; // Summed per measurement
+
+static volatile uint8_t s_sink;
+
+static double run(SumFn sum, const uint8_t *data, size_t size)
+{
+    size_t rounds = kBytes / size;
+    uint8_t total = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < rounds; i++)
+        total += sum(data, size);
+    auto end = std::chrono::steady_clock::now();
+
+    s_sink = total;
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return rounds * size / seconds / 1e9;
+}
+
+int main()
+{
+    struct Routine {
+        const char *name;
+        SumFn sum;
+    };
+    const Routine routines[] = {
+        { "bytes", checksum::sum_bytes },
+        { "unrolled", checksum::sum_unrolled },
+        { "words", checksum::sum_words },
+#ifdef LUTIL_SUM8_SSE2
+        { "sse2", checksum::sum_sse2 },
+#endif
+        { "sum8", checksum::sum8 },
+    };
+    const size_t sizes[] = { 16, 64, 256, 1024, 4096, 16384, 65536 };
+
+    // +1 so every size also runs unaligned
+    static uint8_t data[65536 + 1];
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = (uint8_t)rand();
+
+    printf("%-10s", "GB/s");
+    for (size_t size : sizes)
+        printf("%9zu B", size);
+    printf("\n");
+
+    int failures = 0;
+    for (const Routine &routine : routines) {
+        printf("%-10s", routine.name);
+        for (size_t size : sizes) {
+            if (routine.sum(data + 1, size) != checksum::sum_bytes(data + 1, size))
+                failures++;
+            printf("%11.2f", run(routine.sum, data + 1, size));
+        }
+        printf("\n");
+    }
+
+    if (failures)
+        printf("!! %d mismatched sums\n", failures);
+    return failures ? 1 : 0;
+}
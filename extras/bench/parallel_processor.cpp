@@ -0,0 +1,110 @@
+/*
+    Host benchmark for lutil::host::ParallelProcessor: ticks/sec for a
+    few hundred simulated state machines, serial Processor::process()
+    against 1 thread up to one per core. Every fourth machine is
+    chained to the three before it.
+
+        g++ -std=c++14 -O2 -DBUILD_LIB -Isrc -pthread extras/bench/parallel_processor.cpp \
+            src/lu_process/process.cpp src/lu_host/parallel_processor.cpp
+*/
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "lutil.h"
+#include "lu_process/process.h"
+#include "lu_host/parallel_processor.h"
+
+static const int kMachines = 400;
+static const int kTicks = 500;
+static const int kWork = 2000; // Steps per process()
+
+/* A small LCG driven state machine, costs roughly the same every tick */
+class Machine : public lutil::Processable {
+public:
+    Machine(uint32_t seed, Machine *input)
+        : _seed(seed), _input(input), _state(seed), _value(0) {}
+
+    void init() override {}
+
+    void process() override {
+        uint32_t value = _value + (_input ? _input->_value : 0);
+        for (int i = 0; i < kWork; i++) {
+            _state = _state * 1664525 + 1013904223;
+            value += (_state >> 28) == (value & 15) ? 1 : 0;
+        }
+        _value = value;
+    }
+
+    void reset() { _state = _seed; _value = 0; }
+    uint32_t value() const { return _value; }
+
+private:
+    uint32_t _seed;
+    Machine *_input;
+    uint32_t _state;
+    uint32_t _value;
+};
+
+static Machine *s_machines[kMachines];
+
+static uint32_t checksum()
+{
+    uint32_t sum = 0;
+    for (Machine *machine : s_machines)
+        sum = sum * 31 + machine->value();
+    return sum;
+}
+
+template<typename TICK>
+static double run(TICK tick, uint32_t &sum)
+{
+    for (Machine *machine : s_machines)
+        machine->reset();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kTicks; i++)
+        tick();
+    auto end = std::chrono::steady_clock::now();
+
+    sum = checksum();
+    return kTicks / std::chrono::duration<double>(end - start).count();
+}
+
+int main()
+{
+    for (int i = 0; i < kMachines; i++)
+        s_machines[i] = new Machine(i + 1, i % 4 ? s_machines[i - 1] : nullptr);
+
+    lutil::Processor &processor = lutil::Processor::get();
+
+    uint32_t expected;
+    double serial = run([&] { processor.process(); }, expected);
+    printf("%-10s %10.0f ticks/s\n", "serial", serial);
+
+    unsigned cores = std::thread::hardware_concurrency();
+    if (cores == 0)
+        cores = 1;
+
+    int failures = 0;
+    for (unsigned threads = 1; threads <= cores; threads *= 2) {
+        lutil::host::ParallelProcessor parallel(threads, processor);
+        for (int i = 0; i < kMachines; i++) {
+            if (i % 4)
+                parallel.depends_on(s_machines[i], s_machines[i - 1]);
+        }
+
+        uint32_t sum;
+        double rate = run([&] { parallel.process(); }, sum);
+        printf("%2u threads %10.0f ticks/s  x%.2f  %llu steals\n",
+               threads, rate, rate / serial,
+               (unsigned long long)parallel.steals());
+
+        if (sum != expected)
+            failures++;
+    }
+
+    if (failures)
+        printf("!! %d runs disagreed with the serial one\n", failures);
+    return failures ? 1 : 0;
+}
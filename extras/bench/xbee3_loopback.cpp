@@ -0,0 +1,270 @@
+/*
+    Host benchmark for the XBee3 receive path, over a simulated serial
+    line (lu_host/mock_stream.h). One XBee3 sends, the other polls -
+    the receiver sees the 0x10 frames exactly as they were written.
+
+    - parse throughput over an instant line, AP=1 and AP=2
+    - time on the wire at 115200 baud (simulated clock)
+    - poll() timing out on a frame that never finishes
+    - recovery from corrupted checksums and from line noise
+
+        g++ -std=c++14 -O2 -DBUILD_LIB -Isrc extras/bench/xbee3_loopback.cpp src/lu_comm/xbee3.cpp
+
+    Or configure with -DLUTIL_BUILD_BENCHMARKS=ON.
+*/
+#include <chrono>
+#include <cstdio>
+
+#include "lutil.h"
+#include "lu_comm/xbee3.h"
+#include "lu_host/mock_stream.h"
+
+using lutil::XBee3;
+using lutil::XBee3Request;
+using lutil::Xbee3Response;
+using lutil::host::LoopbackPair;
+using lutil::host::ManualClock;
+
+static const lutil::XBee3Address kAddress{ 0x0013A200, 0x41BDFAFB };
+
+// Where our payload starts in a 0x10 (after the API id: frame id,
+// address, network address, radius and options)
+static const size_t kPayloadOffset = 13;
+
+static int s_failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("  %-48s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+        s_failures++;
+}
+
+static void fill(XBee3Request &request, uint8_t *payload, size_t size, uint32_t seq)
+{
+    for (size_t i = 0; i < size; i++)
+        payload[i] = (uint8_t)(seq * 31 + i);
+    memcpy(payload, &seq, sizeof(seq));
+    request.setPayload(payload, (uint16_t)size);
+}
+
+// seq of a received frame, or -1 if it isn't one of ours
+static long long sequence(const Xbee3Response &response, size_t size)
+{
+    const lutil::data_view &frame = response.payload();
+    if (frame.size() != kPayloadOffset + size)
+        return -1;
+
+    uint32_t seq;
+    memcpy(&seq, frame.get() + kPayloadOffset, sizeof(seq));
+    for (size_t i = sizeof(seq); i < size; i++)
+        if (frame[kPayloadOffset + i] != (uint8_t)(seq * 31 + i))
+            return -1;
+    return seq;
+}
+
+// ------------------------------------------------------------------
+
+static void throughput(size_t payload, bool escaped)
+{
+    static const int kFrames = 200000;
+    static const int kBatch = 32;
+
+    LoopbackPair link(1 << 16);
+    XBee3 sender, receiver;
+    sender.setStream(&link.a());
+    receiver.setStream(&link.b());
+    sender.setEscaped(escaped);
+    receiver.setEscaped(escaped);
+
+    XBee3Request request(kAddress);
+    uint8_t data[256];
+
+    int received = 0;
+    int bad = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int sent = 0; sent < kFrames; ) {
+        for (int i = 0; i < kBatch; i++, sent++) {
+            fill(request, data, payload, sent);
+            sender.send(request);
+        }
+
+        Xbee3Response::Status status;
+        while ((status = receiver.poll()) != Xbee3Response::None) {
+            if (status == Xbee3Response::Valid)
+                received += sequence(receiver.response(), payload) >= 0;
+            else
+                bad++;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    printf("  AP=%d %4zu B payload  %10.0f frames/s  %7.1f MB/s\n",
+           escaped ? 2 : 1, payload, kFrames / seconds,
+           link.b().stats().delivered / seconds / 1e6);
+    if (received != kFrames || bad)
+        check(false, "every frame received");
+}
+
+static void wire_time()
+{
+    ManualClock clock;
+    LoopbackPair link;
+    link.setBaud(115200);
+
+    XBee3 sender, receiver;
+    sender.setStream(&link.a());
+    receiver.setStream(&link.b());
+
+    XBee3Request request(kAddress);
+    uint8_t data[64];
+    fill(request, data, sizeof(data), 7);
+    sender.send(request);
+
+    uint64_t start = clock.now_us();
+    while (receiver.poll() != Xbee3Response::Valid && clock.now_us() - start < 1000000)
+        clock.advance_us(50);
+
+    double expected = request.frame_size() * 10 * 1e6 / 115200;
+    printf("  %zu B frame at 115200 baud: %llu us (line time %.0f us)\n",
+           request.frame_size(), (unsigned long long)(clock.now_us() - start), expected);
+    check(clock.now_us() - start < expected + 100, "arrives as soon as the line allows");
+}
+
+static void timeout()
+{
+    ManualClock clock;
+    LoopbackPair link;
+
+    XBee3 sender, receiver;
+    sender.setStream(&link.a());
+    receiver.setStream(&link.b());
+    receiver.setTimeout(100);
+
+    XBee3Request request(kAddress);
+    uint8_t data[32];
+    fill(request, data, sizeof(data), 1);
+    uint8_t frame[64];
+    size_t size = request.serialize_into(frame, sizeof(frame));
+
+    // Half a frame, then silence
+    link.b().inject(frame, size / 2);
+    check(receiver.poll() == Xbee3Response::InProgress, "half a frame is in progress");
+
+    clock.advance_ms(50);
+    check(receiver.poll() == Xbee3Response::InProgress, "still waiting inside the timeout");
+
+    clock.advance_ms(60);
+    check(receiver.poll() == Xbee3Response::Timeout, "times out");
+
+    fill(request, data, sizeof(data), 2);
+    sender.send(request);
+    check(receiver.poll() == Xbee3Response::Valid &&
+          sequence(receiver.response(), sizeof(data)) == 2, "next frame parses");
+}
+
+static void bad_checksums()
+{
+    static const int kFrames = 1000;
+
+    LoopbackPair link(1 << 16);
+    XBee3 sender, receiver;
+    sender.setStream(&link.a());
+    receiver.setStream(&link.b());
+
+    XBee3Request request(kAddress);
+    uint8_t data[48];
+
+    int valid = 0, invalid = 0;
+    for (int i = 0; i < kFrames; i++) {
+        fill(request, data, sizeof(data), i);
+        sender.send(request);
+        if (i % 10 == 3) // Last byte written, the checksum
+            link.b().corrupt(link.b().buffered() - 1, 0x40);
+
+        Xbee3Response::Status status;
+        while ((status = receiver.poll()) != Xbee3Response::None) {
+            if (status == Xbee3Response::Valid)
+                valid += sequence(receiver.response(), sizeof(data)) == i;
+            else if (status == Xbee3Response::Invalid)
+                invalid++;
+        }
+    }
+    printf("  %d frames, every 10th checksum corrupted: %d valid, %d invalid\n",
+           kFrames, valid, invalid);
+    check(valid == kFrames - kFrames / 10 && invalid == kFrames / 10,
+          "only the corrupted frames are lost");
+}
+
+static void noise(bool escaped)
+{
+    static const int kFrames = 20000;
+
+    ManualClock clock;
+    LoopbackPair link(1 << 16);
+    link.b().setNoise(5000, 20000, 42);
+
+    XBee3 sender, receiver;
+    sender.setStream(&link.a());
+    receiver.setStream(&link.b());
+    sender.setEscaped(escaped);
+    receiver.setEscaped(escaped);
+    receiver.setTimeout(20);
+
+    XBee3Request request(kAddress);
+    uint8_t data[64];
+
+    int valid = 0, wrong = 0, errors = 0, timeouts = 0;
+    for (int i = 0; i < kFrames; i++) {
+        fill(request, data, sizeof(data), i);
+        sender.send(request);
+
+        Xbee3Response::Status status;
+        while ((status = receiver.poll()) != Xbee3Response::None) {
+            if (status == Xbee3Response::Valid) {
+                if (sequence(receiver.response(), sizeof(data)) >= 0)
+                    valid++;
+                else
+                    wrong++;
+            }
+            else if (status == Xbee3Response::Timeout)
+                timeouts++;
+            else if (status != Xbee3Response::InProgress)
+                errors++;
+            else
+                clock.advance_ms(25); // Stuck on a short frame
+        }
+    }
+
+    const lutil::host::MockStream::Stats &stats = link.b().stats();
+    printf("  AP=%d %d frames, %llu bits flipped, %llu bytes dropped:\n"
+           "       %d received (%.2f%%), %d errors, %d timeouts, %d corrupt accepted\n",
+           escaped ? 2 : 1, kFrames,
+           (unsigned long long)stats.flipped, (unsigned long long)stats.dropped,
+           valid, 100.0 * valid / kFrames, errors, timeouts, wrong);
+    check(wrong == 0, "no corrupted frame accepted");
+}
+
+int main()
+{
+    printf("Parse throughput (instant line)\n");
+    const size_t payloads[] = { 16, 64, 200 };
+    for (size_t payload : payloads) {
+        throughput(payload, false);
+        throughput(payload, true);
+    }
+
+    printf("Wire time\n");
+    wire_time();
+
+    printf("Timeouts\n");
+    timeout();
+
+    printf("Recovery\n");
+    bad_checksums();
+    noise(false);
+    noise(true);
+
+    return s_failures ? 1 : 0;
+}
@@ -0,0 +1,128 @@
+/*
+    Host benchmark for the XBee3 send path. Frames go out to a Stream
+    that only counts bytes so we measure our own cost: frames/sec and
+    heap bytes allocated per frame.
+
+        g++ -std=c++14 -O2 -DBUILD_LIB -Isrc extras/bench/xbee3_send.cpp src/lu_comm/xbee3.cpp
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "lutil.h"
+#include "lu_comm/xbee3.h"
+
+// ------------------------------------------------------------------
+// Allocation counter
+
+static size_t s_allocations = 0;
+static size_t s_allocated = 0;
+
+__attribute__((noinline)) void *operator new(size_t size)
+{
+    void *block = malloc(size ? size : 1);
+    if (!block)
+        throw std::bad_alloc();
+    s_allocations++;
+    s_allocated += size;
+    return block;
+}
+
+__attribute__((noinline)) void operator delete(void *data) noexcept
+{
+    free(data);
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete[](void *data) noexcept { operator delete(data); }
+void operator delete(void *data, size_t) noexcept { operator delete(data); }
+void operator delete[](void *data, size_t) noexcept { operator delete(data); }
+
+// ------------------------------------------------------------------
+
+/* Stream that swallows everything (a UART with infinite baud) */
+class NullStream : public Stream {
+public:
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+
+    size_t write(uint8_t) override {
+        _bytes++;
+        return 1;
+    }
+
+    size_t write(const uint8_t *, size_t size) override {
+        _bytes += size;
+        return size;
+    }
+
+    size_t bytes() const { return _bytes; }
+
+private:
+    size_t _bytes = 0;
+};
+
+static const int kFrames = 1000000;
+
+template<typename SEND>
+static void run(const char *name, size_t payload, SEND send, size_t escapes = 0)
+{
+    lutil::XBee3Address addr{ 0x0013A200, 0x41BDFAFB };
+    lutil::XBee3Request request(addr);
+    lutil::managed_data data(payload);
+    request.setPayload(data);
+
+    NullStream stream;
+    size_t allocations = s_allocations;
+    size_t allocated = s_allocated;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kFrames; i++)
+        send(request, stream);
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    printf("%-16s %4zu B payload  %10.0f frames/s  %6.2f allocs/frame  %8.1f B/frame\n",
+           name, payload, kFrames / seconds,
+           (double)(s_allocations - allocations) / kFrames,
+           (double)(s_allocated - allocated) / kFrames);
+
+    size_t expected = (request.frame_size() + escapes) * kFrames;
+    if (stream.bytes() != expected)
+        printf("  !! wrote %zu bytes, expected %zu\n", stream.bytes(), expected);
+}
+
+int main()
+{
+    const size_t payloads[] = { 16, 64, 200 };
+
+    for (size_t payload : payloads) {
+        // The old path: build a whole frame on the heap (now freed)
+        run("data()", payload, [](const lutil::XBee3Request &r, NullStream &s) {
+            lutil::RawData d = r.data();
+            s.write(d.data, d.size);
+            delete [] d.data;
+        });
+
+        // One caller owned buffer, reused
+        run("serialize_into", payload, [](const lutil::XBee3Request &r, NullStream &s) {
+            static uint8_t buffer[lutil::XBee3Request::kHeaderSize + 256 + 1];
+            size_t size = r.serialize_into(buffer, sizeof(buffer));
+            s.write(buffer, size);
+        });
+
+        // Scatter/gather straight to the stream (XBee3::send)
+        run("write_to", payload, [](const lutil::XBee3Request &r, NullStream &s) {
+            r.write_to(s);
+        });
+
+        // Same, framed for AP=2. The payload is zeros, only the 0x13
+        // in the address needs escaping.
+        run("write_to AP=2", payload, [](const lutil::XBee3Request &r, NullStream &s) {
+            r.write_to(s, true);
+        }, 1);
+    }
+    return 0;
+}
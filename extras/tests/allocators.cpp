@@ -0,0 +1,94 @@
+/*
+    Host check of the arena and pool allocators, as the README uses
+    them.
+
+        g++ -std=c++14 -O2 -DBUILD_LIB -Isrc extras/tests/allocators.cpp
+*/
+#include <cstdio>
+
+#include "lutil.h"
+#include "lu_memory/allocators.h"
+#include "lu_storage/map.h"
+#include "lu_storage/vector.h"
+
+#include "check.h"
+
+/* The README example, built with braces */
+void arena_frame()
+{
+    lutil::StaticArena<512> frame_arena;
+    {
+        lutil::Vec<uint8_t, lutil::ArenaAlloc<uint8_t>> frame{
+            lutil::ArenaAlloc<uint8_t>(frame_arena)
+        };
+        lutil::Map<int, float, lutil::ArenaAlloc<uint8_t>> readings{
+            lutil::ArenaAlloc<uint8_t>(frame_arena)
+        };
+
+        frame.push(0x7E);
+        readings[3] = 1.5f;
+        CHECK(frame.count() == 1 && frame[0] == 0x7E);
+        CHECK(readings[3] == 1.5f);
+        CHECK(frame_arena.used() > 0);
+    }
+    frame_arena.reset();
+    CHECK(frame_arena.used() == 0);
+}
+
+/* Only the most recent allocation is given back */
+void arena_lifo()
+{
+    lutil::StaticArena<1024> arena;
+    void *a = arena.allocate(16);
+    void *b = arena.allocate(16);
+    size_t used = arena.used();
+
+    arena.deallocate(a, 16); // Not on top, stays
+    CHECK(arena.used() == used);
+    arena.deallocate(b, 16);
+    CHECK(arena.used() < used);
+
+    // A Vec growing strands the blocks it grew out of, until reset()
+    {
+        lutil::Vec<int, lutil::ArenaAlloc<int>> values{ lutil::ArenaAlloc<int>(arena) };
+        for (int i = 0; i < 32; i++)
+            values.push(i);
+        CHECK(values[31] == 31);
+    }
+    CHECK(arena.used() > 32 * sizeof(int));
+    arena.reset();
+    CHECK(arena.used() == 0);
+}
+
+void pool()
+{
+    lutil::StaticPool<24, 4> blocks;
+    CHECK(blocks.available() == 4);
+
+    void *taken[5];
+    for (int i = 0; i < 5; i++)
+        taken[i] = blocks.allocate(24);
+    CHECK(taken[3] != nullptr && taken[4] == nullptr);
+    CHECK(blocks.allocate(8) == nullptr);
+
+    blocks.deallocate(taken[0], 24);
+    CHECK(blocks.available() == 1);
+
+    // A buffer smaller than its alignment slack makes an empty pool
+    alignas(LUTIL_MAX_ALIGN) uint8_t buffer[64];
+    lutil::BlockPool tiny(buffer + 1, 4, 8);
+    CHECK(tiny.available() == 0);
+    CHECK(tiny.allocate(8) == nullptr);
+
+    lutil::BlockPool shifted(buffer + 1, sizeof(buffer) - 1, 8);
+    CHECK(shifted.available() == (sizeof(buffer) - LUTIL_MAX_ALIGN) / shifted.block_size());
+}
+
+int main()
+{
+    arena_frame();
+    arena_lifo();
+    pool();
+
+    return check_result();
+}
@@ -0,0 +1,36 @@
+/*
+    The bits every host check in extras/tests shares: a CHECK() that
+    reports and counts failures without stopping, and the exit code
+    that goes with it.
+
+    .. code-block:: cpp
+
+        #include "check.h"
+
+        int main()
+        {
+            CHECK(1 + 1 == 2);
+            return check_result();
+        }
+*/
+#pragma once
+#include <cstdio>
+
+static int s_failures = 0;
+
+#define CHECK(cond)                                                   \
+    if (!(cond)) {                                                    \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);        \
+        s_failures++;                                                 \
+    }
+
+// "ok" and 0, or how many checks failed and 1
+static int check_result()
+{
+    if (s_failures) {
+        printf("%d failure(s)\n", s_failures);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
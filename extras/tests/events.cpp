@@ -0,0 +1,178 @@
+/*
+    Host check of posted events with two producers at once: the loop
+    calling post() and an "interrupt" (a thread here) calling
+    post_from_isr(). Every event has to arrive exactly once and, per
+    producer, in order. Also callbacks that add callbacks while they
+    are being called.
+
+        g++ -std=c++14 -O2 -DBUILD_LIB -Isrc -pthread extras/tests/events.cpp src/lu_process/process.cpp
+*/
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "lutil.h"
+#include "lu_process/process.h"
+
+#include "check.h"
+
+static const uint32_t kEvents = 20000; // From each producer
+
+class Sink : public lutil::Processable {
+public:
+    enum Trigger { FromLoop = 0, FromIsr = 1 };
+
+    Sink() : received{ 0, 0 }, out_of_order(0) {
+        when(FromLoop, [this] { _receive(FromLoop); });
+        when(FromIsr, [this] { _receive(FromIsr); });
+    }
+
+    void init() override {}
+    void process() override {}
+
+    uint32_t received[2];
+    uint32_t out_of_order;
+
+private:
+    void _receive(int from) {
+        const lutil::Event *event = lutil::Processor::get().current_event();
+        if (!event || event->payload != received[from])
+            out_of_order++;
+        received[from]++;
+    }
+};
+
+void two_producers()
+{
+    lutil::Processor &processor = lutil::Processor::get();
+    static Sink sink;
+    sink.sleep();
+
+    std::atomic<bool> go(false);
+    std::thread isr([&] {
+        while (!go.load())
+            std::this_thread::yield();
+        for (uint32_t i = 0; i < kEvents; i++) {
+            while (!sink.post_from_isr(Sink::FromIsr, i))
+                std::this_thread::yield(); // Full, the loop will get to it
+        }
+    });
+
+    go.store(true);
+    uint32_t sent = 0;
+    while (sent < kEvents || sink.received[0] < kEvents || sink.received[1] < kEvents) {
+        // A few posts a turn, then let the Processor deliver
+        for (int i = 0; i < 4 && sent < kEvents; i++) {
+            if (sink.post(Sink::FromLoop, sent))
+                sent++;
+        }
+        processor.process();
+        std::this_thread::yield();
+    }
+    isr.join();
+
+    CHECK(sink.received[0] == kEvents);
+    CHECK(sink.received[1] == kEvents);
+    CHECK(sink.out_of_order == 0);
+    CHECK(processor.events_pending() == 0);
+}
+
+/* Neither queue can starve the other under the budget */
+void take_turns()
+{
+    lutil::Processor &processor = lutil::Processor::get();
+    static Sink sink;
+    sink.sleep();
+
+    processor.set_event_budget(4);
+    for (uint32_t i = 0; i < 6; i++) {
+        sink.post(Sink::FromLoop, i);
+        sink.post_from_isr(Sink::FromIsr, i);
+    }
+    CHECK(processor.events_pending() == 12);
+    CHECK(processor.idle_for() == 0);
+
+    processor.process();
+    CHECK(sink.received[0] == 2);
+    CHECK(sink.received[1] == 2);
+
+    processor.set_event_budget(LUTIL_EVENT_BUDGET);
+    processor.process();
+    processor.process();
+    CHECK(sink.received[0] == 6);
+    CHECK(sink.received[1] == 6);
+    CHECK(sink.out_of_order == 0);
+}
+
+class Recorder : public lutil::Processable {
+public:
+    enum Trigger { Low = 0, High = 1 };
+
+    Recorder() : length(0) { log[0] = '\0'; }
+
+    void init() override {}
+    void process() override {}
+
+    void fire(int trigger) { event(trigger); }
+
+    void record(char c) {
+        if (length < sizeof(log) - 1) {
+            log[length++] = c;
+            log[length] = '\0';
+        }
+    }
+
+    char log[16];
+    size_t length;
+};
+
+/* Adding to a lower trigger shifts our run, nothing runs twice */
+void add_lower_while_calling()
+{
+    static Recorder recorder;
+    recorder.sleep();
+
+    recorder.when(Recorder::Low, [] {});
+    recorder.when(Recorder::High, [] {
+        recorder.record('x');
+        recorder.when(Recorder::Low, [] {});
+    });
+    recorder.when(Recorder::High, [] { recorder.record('z'); });
+
+    recorder.fire(Recorder::High);
+    CHECK(strcmp(recorder.log, "xz") == 0);
+}
+
+/* Runs once and leaves another copy of itself for the next call */
+static void spawn(void *data)
+{
+    Recorder *recorder = (Recorder *)data;
+    recorder->record('a');
+    recorder->when(Recorder::Low, &spawn, recorder);
+}
+
+/* Callbacks added to the trigger being called wait for the next call */
+void add_same_while_calling()
+{
+    static Recorder recorder;
+    recorder.sleep();
+
+    recorder.when(Recorder::Low, &spawn, &recorder);
+
+    recorder.fire(Recorder::Low);
+    CHECK(strcmp(recorder.log, "a") == 0);
+
+    recorder.fire(Recorder::Low);
+    CHECK(strcmp(recorder.log, "aaa") == 0);
+}
+
+int main()
+{
+    two_producers();
+    take_turns();
+    add_lower_while_calling();
+    add_same_while_calling();
+
+    return check_result();
+}
@@ -0,0 +1,116 @@
+/*
+    Host check of FlatMap and FrozenFlatMap.
+
+        g++ -std=c++14 -O2 -DBUILD_LIB -Isrc extras/tests/flat_map.cpp
+*/
+#include <cstdio>
+
+#include "lutil.h"
+#include "lu_storage/flat_map.h"
+#include "lu_storage/map.h"
+
+#include "check.h"
+
+/* Out of order inserts come back sorted, repeats overwrite */
+void inserts()
+{
+    lutil::FlatMap<int, int> map;
+    const int keys[] = { 7, 3, 9, 1, 5, 3 };
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+        map.insert(keys[i], (int)i);
+
+    CHECK(map.count() == 5);
+    CHECK(map.contains(1) && map.contains(9));
+    CHECK(!map.contains(4));
+    CHECK(map.find(4) == nullptr);
+    CHECK(map.find(3) && *map.find(3) == 5);
+
+    int last = -1;
+    for (auto it = map.begin(); it != map.end(); it++) {
+        CHECK(it.key() > last);
+        last = it.key();
+    }
+
+    map[4] = 40;
+    CHECK(map.count() == 6);
+    CHECK(*map.find(4) == 40);
+
+    map.remove(7);
+    map.remove(8); // Not there
+    CHECK(map.count() == 5);
+    CHECK(!map.contains(7));
+    CHECK(map.key_from_value(40) == 4);
+}
+
+/* One sort for the whole batch, the last of a repeated key wins */
+void batch()
+{
+    const int keys[] = { 40, 10, 30, 10, 20 };
+    const int values[] = { 4, 1, 3, 11, 2 };
+
+    lutil::FlatMap<int, int> map;
+    map.insert(99, 99); // Replaced by the build
+    map.build_from(keys, values, 5);
+
+    CHECK(map.count() == 4);
+    CHECK(!map.contains(99));
+    CHECK(*map.find(10) == 11);
+
+    int expected[] = { 10, 20, 30, 40 };
+    int i = 0;
+    for (auto it = map.begin(); it != map.end(); it++, i++)
+        CHECK(it.key() == expected[i]);
+
+    lutil::Map<int, int> source;
+    source.insert(3, 30);
+    source.insert(1, 10);
+    source.insert(2, 20);
+
+    lutil::FlatMap<int, int> copy;
+    copy.build_from(source);
+    CHECK(copy.count() == 3);
+    CHECK(copy.begin().key() == 1);
+    CHECK(*copy.find(2) == 20);
+
+    lutil::Map<int, int> empty;
+    copy.build_from(empty);
+    CHECK(copy.count() == 0);
+}
+
+/* Owning values are moved about as keys shift, not leaked or shared */
+void owning_values()
+{
+    lutil::FlatMap<int, lutil::Vec<int>> map;
+    for (int k = 20; k > 0; k--)
+        map[k].push(k);
+    map[10].push(100);
+
+    CHECK(map.count() == 20);
+    CHECK(map.find(1)->count() == 1);
+    CHECK((*map.find(10))[1] == 100);
+    CHECK((*map.find(20))[0] == 20);
+}
+
+void frozen()
+{
+    static const uint16_t kIds[] = { 1, 4, 9 };
+    static const char *const kNames[] = { "one", "four", "nine" };
+    lutil::FrozenFlatMap<uint16_t, const char *> names(kIds, kNames, 3);
+
+    CHECK(names.count() == 3);
+    CHECK(names.find(4) && *names.find(4) == kNames[1]);
+    CHECK(names.find(5) == nullptr);
+    CHECK(names.find(0) == nullptr);
+    CHECK(names.find(10) == nullptr);
+    CHECK(names.key(2) == 9);
+}
+
+int main()
+{
+    inserts();
+    batch();
+    owning_values();
+    frozen();
+
+    return check_result();
+}
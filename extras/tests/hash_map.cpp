@@ -0,0 +1,61 @@
+/*
+    Host check of HashMap keying and of what a full fixed map does.
+
+        g++ -std=c++14 -O2 -DBUILD_LIB -Isrc extras/tests/hash_map.cpp
+*/
+#include <cstdio>
+#include <cstring>
+
+#include "lutil.h"
+#include "lu_storage/hash_map.h"
+
+#include "check.h"
+
+/* The same text at two addresses is one key */
+void string_keys()
+{
+    char first[8], second[8];
+    strcpy(first, "motor");
+    strcpy(second, "motor");
+
+    lutil::HashMap<const char *, int> map;
+    map[first] = 1;
+    CHECK(map.contains(second));
+    CHECK(map[second] == 1);
+
+    map.insert(second, 2);
+    CHECK(map.count() == 1);
+    CHECK(map[first] == 2);
+
+    CHECK(!map.contains("pump"));
+    map.remove(second);
+    CHECK(map.count() == 0);
+}
+
+void fixed_full()
+{
+    lutil::HashMap<int, int, lutil::Hash<int>, 4> map;
+    lutil::HashMap<int, int, lutil::Hash<int>, 4> other;
+
+    for (int k = 0; k < 4; k++) {
+        CHECK(map.insert(k, k));
+        CHECK(other.insert(k, k));
+    }
+    CHECK(!map.insert(4, 4));
+
+    // Scratch: private to the map, reset every time, never stored
+    map[10] = 5;
+    CHECK(map[11] == 0);
+    CHECK(&map[12] != &other[12]);
+    CHECK(!map.contains(10));
+    CHECK(map.count() == 4);
+    CHECK(map[3] == 3);
+}
+
+int main()
+{
+    string_keys();
+    fixed_full();
+
+    return check_result();
+}
@@ -0,0 +1,84 @@
+/*
+    Host check of managed_data::reset(), including sources that point
+    into the buffer being reset. Build with -fsanitize=address to have
+    a use after free reported rather than just (maybe) misread.
+
+        g++ -std=c++14 -O2 -DBUILD_LIB -Isrc extras/tests/managed_data.cpp
+*/
+#include <cstdio>
+
+#include "lutil.h"
+#include "lu_memory/managed_ptr.h"
+
+#include "check.h"
+
+static lutil::managed_data counting(size_t size)
+{
+    lutil::managed_data d(size);
+    for (size_t i = 0; i < size; i++)
+        d[(int)i] = (uint8_t)i;
+    return d;
+}
+
+/* Drop the first two bytes of our own buffer (new size, new buffer) */
+void aliased_shrink()
+{
+    lutil::managed_data d = counting(8);
+    d.reset(d.get() + 2, 6);
+
+    CHECK(d.size() == 6);
+    for (int i = 0; i < 6; i++)
+        CHECK(d[i] == i + 2);
+}
+
+/* Same size, so the buffer is reused and copied onto itself */
+void aliased_in_place()
+{
+    lutil::managed_data d = counting(8);
+    uint8_t *buffer = d.get();
+
+    d.reset(buffer, 8);
+    CHECK(d.get() == buffer);
+    for (int i = 0; i < 8; i++)
+        CHECK(d[i] == i);
+}
+
+/* Someone else holds the buffer, they keep the old bytes */
+void aliased_shared()
+{
+    lutil::managed_data d = counting(8);
+    lutil::managed_data other = d;
+
+    d.reset(d.get() + 4, 4);
+    CHECK(d.size() == 4);
+    CHECK(d.get() != other.get());
+    for (int i = 0; i < 4; i++)
+        CHECK(d[i] == i + 4);
+    for (int i = 0; i < 8; i++)
+        CHECK(other[i] == i);
+}
+
+/* From nothing, and from someone else's bytes */
+void plain()
+{
+    const uint8_t bytes[] = { 9, 8, 7 };
+
+    lutil::managed_data d;
+    d.reset((uint8_t *)bytes, 3);
+    CHECK(d.size() == 3);
+    CHECK(d[0] == 9 && d[2] == 7);
+
+    d.reset((uint8_t *)bytes + 1, 2);
+    CHECK(d.size() == 2);
+    CHECK(d[0] == 8 && d[1] == 7);
+}
+
+int main()
+{
+    aliased_shrink();
+    aliased_in_place();
+    aliased_shared();
+    plain();
+
+    return check_result();
+}
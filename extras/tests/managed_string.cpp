@@ -0,0 +1,96 @@
+/*
+    Host check of managed_string: assigning from our own characters
+    and writing through get() while a copy shares the buffer. Build
+    with -fsanitize=address to have a use after free reported.
+
+        g++ -std=c++14 -O2 -DBUILD_LIB -Isrc extras/tests/managed_string.cpp
+*/
+#include <cstdio>
+#include <cstring>
+
+#include "lutil.h"
+#include "lu_memory/managed_ptr.h"
+
+#include "check.h"
+
+static const char *kLong = "0123456789abcdefghijklmnopqrstuvwxyzABCD"; // 40
+
+/* The tail of a heap string is short enough to go inline */
+void aliased_to_inline()
+{
+    lutil::managed_string s(kLong);
+    CHECK(!s.is_inline());
+
+    s = s.c_str() + 32;
+    CHECK(s.is_inline());
+    CHECK(s.size() == 8);
+    CHECK(s == "wxyzABCD");
+}
+
+/* Still on the heap, the buffer is reused and copied onto itself */
+void aliased_in_place()
+{
+    lutil::managed_string s(kLong);
+    const char *buffer = s.c_str();
+
+    s = s.c_str() + 4;
+    CHECK(s.c_str() == buffer);
+    CHECK(s.size() == 36);
+    CHECK(s == kLong + 4);
+}
+
+void aliased_inline()
+{
+    lutil::managed_string s("hello world");
+    s = s.c_str() + 6;
+    CHECK(s == "world");
+
+    s = s.c_str();
+    CHECK(s == "world");
+}
+
+/* A copy holds the buffer, it keeps the old characters */
+void aliased_shared()
+{
+    lutil::managed_string s(kLong);
+    lutil::managed_string other = s;
+
+    s = s.c_str() + 2;
+    CHECK(s == kLong + 2);
+    CHECK(other == kLong);
+}
+
+/* Writing to one copy leaves the other, and its hash, alone */
+void write_shared()
+{
+    lutil::managed_string a(kLong);
+    lutil::managed_string b = a;
+    CHECK(a.c_str() == b.c_str());
+    a.hash();
+    b.hash();
+
+    b.get()[0] = 'X';
+    CHECK(a.c_str() != b.c_str());
+    CHECK(a == kLong);
+    CHECK(b.c_str()[0] == 'X');
+
+    lutil::managed_string same(kLong);
+    same.hash();
+    CHECK(a == same);
+    CHECK(a.hash() == same.hash());
+    CHECK(b != same);
+
+    b.get()[0] = '0';
+    CHECK(b == same);
+}
+
+int main()
+{
+    aliased_to_inline();
+    aliased_in_place();
+    aliased_inline();
+    aliased_shared();
+    write_shared();
+
+    return check_result();
+}
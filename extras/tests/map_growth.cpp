@@ -0,0 +1,183 @@
+/*
+    Host check that Map growth doesn't leak and that memory stays
+    flat under millions of inserts.
+
+        g++ -std=c++14 -O2 -DBUILD_LIB -Isrc extras/tests/map_growth.cpp
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "lutil.h"
+#include "lu_storage/map.h"
+#include "lu_storage/vector.h"
+
+#include "check.h"
+
+// ------------------------------------------------------------------
+// Allocator counter. Every block carries its size in a small header
+// so the delete side knows what it's giving back.
+
+static size_t s_live = 0;
+static size_t s_peak = 0;
+static size_t s_allocations = 0;
+
+static const size_t kHeader = 16; // Keeps the payload max aligned
+
+// Kept out of line so the compiler can't pair our malloc/free with
+// the new/delete expressions and complain about a mismatch.
+__attribute__((noinline)) void *operator new(size_t size)
+{
+    uint8_t *block = (uint8_t *)malloc(size + kHeader);
+    if (!block)
+        throw std::bad_alloc();
+
+    *(size_t *)block = size;
+    s_live += size;
+    s_allocations++;
+    if (s_live > s_peak)
+        s_peak = s_live;
+    return block + kHeader;
+}
+
+__attribute__((noinline)) void operator delete(void *data) noexcept
+{
+    if (!data)
+        return;
+    uint8_t *block = (uint8_t *)data - kHeader;
+    s_live -= *(size_t *)block;
+    free(block);
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete[](void *data) noexcept { operator delete(data); }
+void operator delete(void *data, size_t) noexcept { operator delete(data); }
+void operator delete[](void *data, size_t) noexcept { operator delete(data); }
+
+// ------------------------------------------------------------------
+
+/*
+    Fill to a few thousand keys then empty it again, over and over.
+    Once the first pass has sized the map, nothing else should be
+    allocated or leaked.
+*/
+void churn()
+{
+    const int kKeys = 2000;
+    const int kPasses = 1000; // 2M inserts
+
+    size_t before = s_live;
+    {
+        lutil::Map<int, int> map;
+        for (int k = 0; k < kKeys; k++)
+            map.insert(k, k);
+
+        size_t sized = s_live;
+        size_t allocations = s_allocations;
+
+        for (int pass = 0; pass < kPasses; pass++) {
+            for (int k = kKeys - 1; k >= 0; k--)
+                map.remove(k);
+            for (int k = 0; k < kKeys; k++)
+                map.insert(k, pass);
+        }
+
+        CHECK(map.count() == (size_t)kKeys);
+        CHECK(map[kKeys - 1] == kPasses - 1);
+        CHECK(s_live == sized);
+        CHECK(s_allocations == allocations);
+    }
+    CHECK(s_live == before);
+}
+
+/*
+    Grow from empty. With the old arrays released on every resize the
+    peak should only ever be the final block plus the one before it.
+*/
+void growth()
+{
+    const int kKeys = 20000;
+
+    size_t before = s_live;
+    {
+        lutil::Map<int, int> map;
+        for (int k = 0; k < kKeys; k++)
+            map.insert(k, k);
+
+        size_t final_size = s_live - before;
+        size_t peak = s_peak - before;
+        printf("growth: capacity %zu, %zu bytes, peak %zu bytes\n",
+               map.capacity(), final_size, peak);
+
+        CHECK(final_size <= map.capacity() * (sizeof(int) * 2) + 16);
+        CHECK(peak <= final_size + final_size / 2 + 16);
+
+        for (int k = 0; k < kKeys; k++) {
+            if (map[k] != k) {
+                CHECK(map[k] == k);
+                break;
+            }
+        }
+    }
+    CHECK(s_live == before);
+}
+
+/* Owning values have to be moved, not leaked or double freed */
+void owning_values()
+{
+    size_t before = s_live;
+    {
+        lutil::Map<int, lutil::Vec<int>> map;
+        map.set_growth(lutil::GrowthPolicy::step(3));
+
+        for (int k = 0; k < 500; k++) {
+            lutil::Vec<int> v;
+            v.push(k);
+            map.insert(k, v);
+        }
+        for (int k = 0; k < 500; k += 2)
+            map.remove(k);
+
+        CHECK(map.count() == 250);
+        CHECK(map[499][0] == 499);
+
+        lutil::Map<int, lutil::Vec<int>> copy = map;
+        copy = map;
+        CHECK(copy[1][0] == 1);
+    }
+    CHECK(s_live == before);
+}
+
+void fixed_capacity()
+{
+    lutil::Map<int, int> map;
+    map.set_growth(lutil::GrowthPolicy::fixed());
+    map.reserve(8);
+
+    for (int k = 0; k < 8; k++)
+        CHECK(map.insert(k, k));
+    CHECK(!map.insert(8, 8));
+    CHECK(map.capacity() == 8);
+
+    // A miss on a full map hands back scratch that's ours alone
+    lutil::Map<int, int> other;
+    other.set_growth(lutil::GrowthPolicy::fixed());
+    other.reserve(1);
+    other.insert(0, 0);
+
+    map[100] = 5;
+    CHECK(&map[101] != &other[101]);
+    CHECK(map[102] == 0);
+    CHECK(!map.contains(100));
+    CHECK(map.count() == 8);
+}
+
+int main()
+{
+    churn();
+    growth();
+    owning_values();
+    fixed_capacity();
+
+    return check_result();
+}
@@ -0,0 +1,151 @@
+/*
+    Host check of Processor scheduling: wake_at() aimed at something
+    that's due in the same tick, lateness stats for tasks that
+    schedule themselves, and moving tasks to another Processor.
+
+        g++ -std=c++14 -O2 -DBUILD_LIB -Isrc extras/tests/processor.cpp src/lu_process/process.cpp
+*/
+#include <cstdio>
+
+#include "lutil.h"
+#include "lu_process/process.h"
+
+#include "check.h"
+
+using lutil::host::ManualClock;
+
+class Task : public lutil::Processable {
+public:
+    Task() : target(nullptr), delay(0), again(0) {}
+
+    void init() override {}
+
+    void process() override {
+        if (target)
+            target->wake_in(delay);
+        if (again)
+            wake_in(again);
+    }
+
+    Task *target; // Woken delay us from now on every run
+    uint32_t delay;
+    uint32_t again; // Wake ourselves this long after each run
+};
+
+/*
+    first and second are both due in the first tick, first runs first
+    (registered first) and pushes second back. second still runs this
+    tick, it was already taken off the heap, then has to wait.
+*/
+void wake_due_task(Task &first, Task &second)
+{
+    ManualClock clock(1000);
+    lutil::Processor &processor = lutil::Processor::get();
+
+    first.target = &second;
+    first.delay = 1000;
+    first.wake_at(1000);
+    second.wake_at(1000);
+
+    processor.process();
+    CHECK(first.stats().runs == 1);
+    CHECK(second.stats().runs == 1);
+
+    first.sleep(); // Don't push it back any further
+    clock.advance_us(999);
+    processor.process();
+    CHECK(second.stats().runs == 1);
+
+    clock.advance_us(1);
+    processor.process();
+    CHECK(second.stats().runs == 2);
+    CHECK(second.sleeping()); // One shot, nobody woke it again
+
+    first.target = nullptr;
+}
+
+/* Lateness is measured against when we were due, not the next wake */
+void late_stats(Task &task)
+{
+    ManualClock clock(5000);
+    lutil::Processor &processor = lutil::Processor::get();
+
+    task.reset_stats();
+    task.again = 500;
+    task.wake_at(5000);
+    for (int i = 0; i < 10; i++) {
+        processor.process();
+        clock.advance_us(i == 4 ? 530 : 500);
+    }
+    task.sleep();
+    task.again = 0;
+
+    CHECK(task.stats().runs == 10);
+    CHECK(task.stats().max_late_us == 30);
+}
+
+/* Out of the global Processor's heap and list, into the other's */
+void move_processor()
+{
+    ManualClock clock(9000);
+    lutil::Processor &global = lutil::Processor::get();
+    lutil::Processor other;
+
+    static Task moved, stays, asleep;
+    moved.again = 100;
+    stays.again = 100;
+    moved.wake_at(9000);
+    stays.wake_at(9000);
+    asleep.sleep();
+
+    other.add_processable(&moved);
+    other.add_processable(&moved); // Already there
+    other.add_processable(&asleep);
+
+    global.process();
+    CHECK(stays.stats().runs == 1);
+    CHECK(moved.stats().runs == 0);
+
+    other.process(); // Both due straight away
+    CHECK(moved.stats().runs == 1);
+    CHECK(asleep.stats().runs == 1);
+
+    for (int i = 0; i < 4; i++) {
+        clock.advance_us(100);
+        global.process();
+        other.process();
+    }
+    CHECK(stays.stats().runs == 5);
+    CHECK(moved.stats().runs == 5);
+    CHECK(asleep.stats().runs == 5); // No period, runs every process()
+
+    // Scheduling goes through the new owner's heap
+    moved.sleep();
+    stays.sleep();
+    clock.advance_us(100);
+    global.process();
+    other.process();
+    CHECK(moved.stats().runs == 5);
+    CHECK(stays.stats().runs == 5);
+
+    // Back again before other goes out of scope
+    global.add_processable(&moved);
+    global.add_processable(&asleep);
+    moved.sleep();
+    asleep.sleep();
+    moved.again = 0;
+    stays.again = 0;
+}
+
+int main()
+{
+    static Task first, second;
+    first.sleep();
+    second.sleep();
+
+    wake_due_task(first, second);
+    late_stats(first);
+    move_processor();
+
+    return check_result();
+}
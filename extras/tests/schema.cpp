@@ -0,0 +1,210 @@
+/*
+    Host check of lu_comm/schema.h: every codec round trips (Raw,
+    Varint, ZigZag, Float16 and Nested), the sizes on the wire are
+    what the header promises and short buffers are refused.
+
+        g++ -std=c++14 -O2 -DBUILD_LIB -Isrc extras/tests/schema.cpp src/lu_math/axis.cpp
+*/
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+#include "lutil.h"
+#include "lu_comm/schema.h"
+
+#include "check.h"
+
+struct Inner {
+    uint8_t id;
+    int32_t value;
+};
+
+struct Reading {
+    lutil::Axis accel;
+    float temperature;
+    uint32_t timestamp;
+    int16_t offset;
+    bool ok;
+    double precise;
+    Inner inner;
+    uint64_t big;
+    int64_t negative;
+};
+
+LU_SCHEMA(Inner,
+    LU_FIELD(id, Raw),
+    LU_FIELD(value, ZigZag)
+);
+
+LU_SCHEMA(Reading,
+    LU_FIELD(accel, Float16),
+    LU_FIELD(temperature, Raw),
+    LU_FIELD(timestamp, Varint),
+    LU_FIELD(offset, ZigZag),
+    LU_FIELD(ok, Raw),
+    LU_FIELD(precise, Raw),
+    LU_FIELD(inner, Nested),
+    LU_FIELD(big, Varint),
+    LU_FIELD(negative, ZigZag)
+);
+
+static_assert(lutil::wire::max_size<Reading>() == 6 + 4 + 5 + 3 + 1 + 8 + (1 + 5) + 10 + 10,
+              "max_size adds up every field's worst case");
+
+static Reading sample()
+{
+    Reading r;
+    r.accel = lutil::Axis(1.5f, -0.25f, 1000.0f); // Exact in half precision
+    r.temperature = 21.3f;
+    r.timestamp = 300;
+    r.offset = -2;
+    r.ok = true;
+    r.precise = 3.14159;
+    r.inner = { 7, -100000 };
+    r.big = ~(uint64_t)0;
+    r.negative = INT64_MIN;
+    return r;
+}
+
+void round_trip()
+{
+    Reading r = sample();
+    uint8_t buffer[lutil::wire::max_size<Reading>()];
+    size_t size = lutil::wire::encode(r, buffer, sizeof(buffer));
+    CHECK(size == 6 + 4 + 2 + 1 + 1 + 8 + (1 + 3) + 10 + 10);
+
+    Reading out;
+    CHECK(lutil::wire::decode(buffer, size, out));
+    CHECK(out.accel.x == 1.5f && out.accel.y == -0.25f && out.accel.z == 1000.0f);
+    CHECK(out.temperature == r.temperature);
+    CHECK(out.timestamp == 300);
+    CHECK(out.offset == -2);
+    CHECK(out.ok);
+    CHECK(out.precise == r.precise);
+    CHECK(out.inner.id == 7 && out.inner.value == -100000);
+    CHECK(out.big == r.big);
+    CHECK(out.negative == INT64_MIN);
+
+    // Raw is little endian whatever the host
+    uint32_t bits;
+    memcpy(&bits, &r.temperature, sizeof(bits));
+    CHECK(buffer[6] == (bits & 0xFF) && buffer[9] == (bits >> 24));
+
+    // Straight from a view of a received buffer
+    lutil::managed_data data;
+    data.reset(buffer, size);
+    Reading viewed;
+    CHECK(lutil::wire::decode(data.slice(0), viewed));
+    CHECK(viewed.inner.value == -100000);
+}
+
+void short_buffers()
+{
+    Reading r = sample();
+    uint8_t buffer[lutil::wire::max_size<Reading>()];
+    size_t size = lutil::wire::encode(r, buffer, sizeof(buffer));
+
+    Reading out;
+    CHECK(!lutil::wire::decode(buffer, size - 1, out));
+    CHECK(lutil::wire::encode(r, buffer, size - 1) == 0);
+    CHECK(lutil::wire::encode(r, nullptr, 0) == 0);
+}
+
+template<typename T, typename CODEC>
+static bool trip(T value, size_t expected_size)
+{
+    uint8_t buffer[16];
+    lutil::wire::Writer out(buffer, sizeof(buffer));
+    CODEC::put(out, value);
+
+    T back = 0;
+    lutil::wire::Reader in(buffer, (size_t)(out.ptr - buffer));
+    CODEC::get(in, back);
+    return out.ok && in.ok && back == value &&
+           (size_t)(out.ptr - buffer) == expected_size && in.ptr == out.ptr;
+}
+
+void varints()
+{
+    using lutil::wire::Varint;
+    using lutil::wire::ZigZag;
+
+    CHECK((trip<uint32_t, Varint>(0, 1)));
+    CHECK((trip<uint32_t, Varint>(127, 1)));
+    CHECK((trip<uint32_t, Varint>(128, 2)));
+    CHECK((trip<uint32_t, Varint>(16383, 2)));
+    CHECK((trip<uint32_t, Varint>(16384, 3)));
+    CHECK((trip<uint32_t, Varint>(0xFFFFFFFF, 5)));
+    CHECK((trip<uint16_t, Varint>(0xFFFF, 3)));
+    CHECK((trip<uint64_t, Varint>(~(uint64_t)0, 10)));
+
+    CHECK((trip<int32_t, ZigZag>(0, 1)));
+    CHECK((trip<int32_t, ZigZag>(-1, 1)));
+    CHECK((trip<int32_t, ZigZag>(63, 1)));
+    CHECK((trip<int32_t, ZigZag>(-64, 1)));
+    CHECK((trip<int32_t, ZigZag>(64, 2)));
+    CHECK((trip<int16_t, ZigZag>(INT16_MIN, 3)));
+    CHECK((trip<int32_t, ZigZag>(INT32_MAX, 5)));
+    CHECK((trip<int32_t, ZigZag>(INT32_MIN, 5)));
+    CHECK((trip<int64_t, ZigZag>(INT64_MIN, 10)));
+
+    // More continuation bytes than a uint32_t can hold
+    const uint8_t long_one[] = { 0x80, 0x80, 0x80, 0x80, 0x80, 0x01 };
+    uint32_t value;
+    lutil::wire::Reader in(long_one, sizeof(long_one));
+    Varint::get(in, value);
+    CHECK(!in.ok);
+
+    // Cut off mid varint
+    const uint8_t cut[] = { 0x80, 0x80 };
+    lutil::wire::Reader short_in(cut, sizeof(cut));
+    Varint::get(short_in, value);
+    CHECK(!short_in.ok);
+}
+
+void halves()
+{
+    using lutil::wire::float_to_half;
+    using lutil::wire::half_to_float;
+
+    // Every half comes back as itself (NaNs stay NaNs)
+    bool all = true;
+    for (uint32_t h = 0; h < 0x10000; h++) {
+        float f = half_to_float((uint16_t)h);
+        uint16_t back = float_to_half(f);
+        if (std::isnan(f))
+            all &= (back & 0x7C00) == 0x7C00 && (back & 0x3FF) != 0;
+        else
+            all &= back == h;
+    }
+    CHECK(all);
+
+    // Rounds to the nearest, ties to even, too big is infinity
+    CHECK(float_to_half(65504.0f) == 0x7BFF);
+    CHECK(float_to_half(65519.0f) == 0x7BFF);
+    CHECK(float_to_half(65520.0f) == 0x7C00);
+    CHECK(float_to_half(1.0f + 1.0f / 2048) == 0x3C00);   // Tie, down to even
+    CHECK(float_to_half(1.0f + 3.0f / 2048) == 0x3C02);   // Tie, up to even
+    CHECK(float_to_half(-2.0f) == 0xC000);
+    CHECK(float_to_half(1e-8f) == 0x0000);                // Below the subnormals
+    CHECK(half_to_float(0x0001) == std::ldexp(1.0f, -24)); // Smallest subnormal
+
+    float value = 21.3f;
+    uint8_t buffer[2];
+    lutil::wire::Writer out(buffer, sizeof(buffer));
+    lutil::wire::Float16::put(out, value);
+    float back;
+    lutil::wire::Reader in(buffer, sizeof(buffer));
+    lutil::wire::Float16::get(in, back);
+    CHECK(std::fabs(back - value) < 0.02f); // ~3 significant digits
+}
+
+int main()
+{
+    round_trip();
+    short_buffers();
+    varints();
+    halves();
+
+    return check_result();
+}
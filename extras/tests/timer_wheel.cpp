@@ -0,0 +1,203 @@
+/*
+    Host check of TimerWheel against a naive model (every timer checked
+    on every step) while starting, restarting and cancelling timers at
+    random, across the millis() rollover. Also delays longer than the
+    wheel spans and more timers firing at once than the event queue
+    holds.
+
+        g++ -std=c++14 -O2 -DBUILD_LIB -Isrc extras/tests/timer_wheel.cpp \
+            src/lu_process/timer_wheel.cpp src/lu_process/process.cpp
+*/
+#include <cstdio>
+
+#include "lutil.h"
+#include "lu_process/timer_wheel.h"
+
+#include "check.h"
+
+using lutil::host::ManualClock;
+
+// millis() wraps a few seconds in
+static const uint64_t kStart = (uint64_t)(0xFFFFFFFFUL - 3000) * 1000;
+
+static const int kTimers = LUTIL_EVENT_BUDGET; // All fit in one delivery
+static const uint32_t kSpan = 1UL << (LUTIL_TIMER_WHEEL_BITS * LUTIL_TIMER_WHEEL_LEVELS);
+
+/* Counts what arrives, the trigger is the timer's index */
+class Sink : public lutil::Processable {
+public:
+    Sink() { clear(); }
+
+    void init() override {}
+    void process() override {}
+
+    void clear() {
+        for (int i = 0; i < kTimers; i++) {
+            fired[i] = 0;
+            due[i] = 0;
+        }
+    }
+
+    static void receive(void *data) {
+        Sink *sink = (Sink *)data;
+        const lutil::Event *event = lutil::Processor::get().current_event();
+        sink->fired[event->trigger]++;
+        sink->due[event->trigger] = event->payload;
+    }
+
+    uint32_t fired[kTimers];
+    uint32_t due[kTimers];
+};
+
+struct Model {
+    bool active;
+    uint32_t expires;
+    uint32_t interval;
+};
+
+static uint32_t s_seed = 12345;
+
+static uint32_t random(uint32_t below)
+{
+    s_seed = s_seed * 1103515245 + 12345;
+    return (s_seed >> 8) % below;
+}
+
+void against_model()
+{
+    ManualClock clock(kStart);
+    lutil::Processor &processor = lutil::Processor::get();
+    lutil::TimerWheel wheel;
+
+    static Sink sink;
+    sink.sleep();
+    for (int i = 0; i < kTimers; i++)
+        sink.when(i, &Sink::receive, &sink);
+
+    lutil::Timer timers[kTimers];
+    Model model[kTimers] = {};
+    uint32_t wrapped = 0;
+
+    for (int step = 0; step < 50000; step++) {
+        // Now and then, start (or restart) or cancel a timer. The
+        // upper half are left to run out, long ones included.
+        int i = (int)random(kTimers);
+        if (random(4) == 0 && !(i >= kTimers / 2 && model[i].active)) {
+            uint32_t now = (uint32_t)millis();
+            if (random(5) == 0) {
+                wheel.cancel(timers[i]);
+                model[i].active = false;
+            }
+            else {
+                // Mostly short, some over a few levels of the wheel
+                uint32_t delay = random(3) ? random(40) : random(40000);
+                uint32_t interval = random(2) ? 4 + random(60) : 0;
+                wheel.start(timers[i], &sink, i, delay, interval);
+                model[i] = { true, now + delay, interval };
+            }
+        }
+
+        // Steps no longer than the shortest interval, so a timer
+        // fires at most once a step
+        uint32_t before = (uint32_t)millis();
+        clock.advance_ms(1 + random(4));
+        uint32_t now = (uint32_t)millis();
+        wrapped += now < before;
+
+        sink.clear();
+        processor.process();
+
+        for (int i = 0; i < kTimers; i++) {
+            uint32_t expected = 0;
+            uint32_t due = 0;
+            if (model[i].active && (int32_t)(now - model[i].expires) >= 0) {
+                expected = 1;
+                due = model[i].expires;
+                if (model[i].interval)
+                    model[i].expires += model[i].interval;
+                else
+                    model[i].active = false;
+            }
+            CHECK(sink.fired[i] == expected);
+            if (expected)
+                CHECK(sink.due[i] == due);
+            CHECK(timers[i].active() == model[i].active);
+        }
+    }
+    CHECK(wrapped == 1);
+
+    for (int i = 0; i < kTimers; i++)
+        wheel.cancel(timers[i]);
+    CHECK(wheel.count() == 0);
+    wheel.sleep(); // Off the Processor before it goes out of scope
+}
+
+/* Past the top level the timer is filed again on the way */
+void beyond_span()
+{
+    ManualClock clock(kStart);
+    lutil::Processor &processor = lutil::Processor::get();
+    lutil::TimerWheel wheel;
+
+    static Sink sink;
+    sink.sleep();
+    sink.when(0, &Sink::receive, &sink);
+
+    lutil::Timer timer;
+    uint32_t delay = kSpan * 2 + 1234;
+    uint32_t expires = (uint32_t)millis() + delay;
+    wheel.start(timer, &sink, 0, delay);
+
+    // Wake whenever the Processor says something is due
+    uint32_t wakes = 0;
+    while (timer.active() && wakes < 1000) {
+        uint32_t idle = processor.idle_for();
+        clock.advance_us(idle ? idle : 1);
+        processor.process();
+        wakes++;
+    }
+
+    CHECK(sink.fired[0] == 1);
+    CHECK(sink.due[0] == expires);
+    CHECK((uint32_t)millis() == expires);
+    CHECK(wakes < 100);
+    CHECK(wheel.sleeping());
+}
+
+/* More timers due at once than the event queue holds, none are lost */
+void burst()
+{
+    ManualClock clock(kStart);
+    lutil::Processor &processor = lutil::Processor::get();
+    lutil::TimerWheel wheel;
+
+    static Sink sink;
+    sink.sleep();
+    sink.when(0, &Sink::receive, &sink);
+
+    static const int kBurst = LUTIL_EVENT_QUEUE * 3;
+    lutil::Timer timers[kBurst];
+    for (int i = 0; i < kBurst; i++)
+        wheel.start(timers[i], &sink, 0, 10);
+
+    clock.advance_ms(10);
+    processor.process();
+    CHECK(sink.fired[0] > 0 && sink.fired[0] < kBurst);
+
+    for (int i = 0; i < kBurst && sink.fired[0] < kBurst; i++) {
+        clock.advance_ms(1);
+        processor.process();
+    }
+    CHECK(sink.fired[0] == kBurst);
+    CHECK(wheel.count() == 0);
+    wheel.sleep();
+}
+
+int main()
+{
+    against_model();
+    beyond_span();
+    burst();
+
+    return check_result();
+}
@@ -0,0 +1,205 @@
+/*
+    Host check of XBee3Reassembler: fragments out of order, repeated,
+    from another message, late and malformed.
+
+        g++ -std=c++14 -O2 -DBUILD_LIB -Isrc extras/tests/xbee3_fragment.cpp \
+            src/lu_comm/xbee3.cpp src/lu_comm/xbee3_fragment.cpp
+*/
+#include <cstdio>
+#include <cstring>
+
+#include "lutil.h"
+#include "lu_comm/xbee3_fragment.h"
+
+#include "check.h"
+
+using lutil::XBee3Reassembler;
+using lutil::host::ManualClock;
+
+static const lutil::XBee3Address kSender{ 0x0013A200, 0x41BDFAFB };
+static const lutil::XBee3Address kOther{ 0x0013A200, 0x41BDFA00 };
+
+static const uint16_t kSize = 100;
+static const uint16_t kChunk = 30; // Four fragments, the last has 10 bytes
+static const uint8_t kCount = 4;
+
+static uint8_t s_message[kSize];
+
+static void fill(uint8_t seed)
+{
+    for (uint16_t i = 0; i < kSize; i++)
+        s_message[i] = (uint8_t)(i * 7 + seed);
+}
+
+// One fragment of s_message, as it comes out of an RX frame. length
+// overrides what a sender would have put in it.
+static lutil::managed_data fragment(uint8_t message, uint8_t index,
+                                    uint8_t count = kCount, uint16_t size = kSize,
+                                    uint16_t length = 0)
+{
+    uint16_t offset = (uint16_t)(index * kChunk);
+    if (!length)
+        length = (offset + kChunk <= size) ? kChunk : (uint16_t)(size - offset);
+
+    lutil::XBee3FragmentHeader header;
+    header.message = message;
+    header.index = index;
+    header.count = count;
+    header.size = size;
+
+    lutil::managed_data payload(lutil::XBee3FragmentHeader::kSize + length);
+    header.write(payload.get());
+    memcpy(payload.get() + lutil::XBee3FragmentHeader::kSize, s_message + offset, length);
+    return payload;
+}
+
+static bool matches(const lutil::data_view &message)
+{
+    return message.size() == kSize && memcmp(message.get(), s_message, kSize) == 0;
+}
+
+void out_of_order()
+{
+    ManualClock clock;
+    XBee3Reassembler messages;
+    fill(1);
+
+    const uint8_t order[] = { 2, 0, 3, 1 };
+    for (int i = 0; i < kCount; i++) {
+        XBee3Reassembler::Status status = messages.add(kSender, fragment(5, order[i]));
+        CHECK(status == (i < kCount - 1 ? XBee3Reassembler::Partial : XBee3Reassembler::Complete));
+    }
+    CHECK(matches(messages.message()));
+
+    // The last fragment first, the chunk size comes from the rest
+    fill(2);
+    CHECK(messages.add(kSender, fragment(6, 3)) == XBee3Reassembler::Partial);
+    CHECK(messages.add(kSender, fragment(6, 1)) == XBee3Reassembler::Partial);
+    CHECK(messages.add(kSender, fragment(6, 0)) == XBee3Reassembler::Partial);
+    CHECK(messages.add(kSender, fragment(6, 2)) == XBee3Reassembler::Complete);
+    CHECK(matches(messages.message()));
+    CHECK(messages.abandoned() == 0);
+}
+
+void duplicates()
+{
+    ManualClock clock;
+    XBee3Reassembler messages;
+    fill(3);
+
+    CHECK(messages.add(kSender, fragment(9, 0)) == XBee3Reassembler::Partial);
+    CHECK(messages.add(kSender, fragment(9, 0)) == XBee3Reassembler::Duplicate);
+    CHECK(messages.add(kSender, fragment(9, 1)) == XBee3Reassembler::Partial);
+    CHECK(messages.add(kSender, fragment(9, 2)) == XBee3Reassembler::Partial);
+    CHECK(messages.add(kSender, fragment(9, 1)) == XBee3Reassembler::Duplicate);
+    CHECK(messages.add(kSender, fragment(9, 3)) == XBee3Reassembler::Complete);
+
+    // Stragglers of the message just completed don't start another
+    CHECK(messages.add(kSender, fragment(9, 2)) == XBee3Reassembler::Duplicate);
+    CHECK(matches(messages.message()));
+    CHECK(messages.abandoned() == 0);
+}
+
+void timed_out()
+{
+    ManualClock clock;
+    XBee3Reassembler messages;
+    messages.setTimeout(500);
+    fill(4);
+
+    CHECK(messages.add(kSender, fragment(1, 0)) == XBee3Reassembler::Partial);
+    CHECK(messages.add(kSender, fragment(1, 1)) == XBee3Reassembler::Partial);
+
+    // Too long a gap, the same message id starts over
+    clock.advance_ms(500);
+    CHECK(messages.add(kSender, fragment(1, 2)) == XBee3Reassembler::Partial);
+    CHECK(messages.abandoned() == 1);
+    CHECK(messages.add(kSender, fragment(1, 3)) == XBee3Reassembler::Partial);
+
+    // Gaps under the timeout are fine, however many
+    for (uint8_t i = 0; i < 2; i++) {
+        clock.advance_ms(499);
+        XBee3Reassembler::Status status = messages.add(kSender, fragment(1, i));
+        CHECK(status == (i == 1 ? XBee3Reassembler::Complete : XBee3Reassembler::Partial));
+    }
+    CHECK(matches(messages.message()));
+
+    // Nor is a late straggler a duplicate, it begins a new message
+    clock.advance_ms(500);
+    CHECK(messages.add(kSender, fragment(1, 0)) == XBee3Reassembler::Partial);
+    CHECK(messages.abandoned() == 1);
+}
+
+/* Another sender or message id abandons the one in progress */
+void interrupted()
+{
+    ManualClock clock;
+    XBee3Reassembler messages;
+    fill(5);
+
+    CHECK(messages.add(kSender, fragment(2, 0)) == XBee3Reassembler::Partial);
+    CHECK(messages.add(kOther, fragment(2, 1)) == XBee3Reassembler::Partial);
+    CHECK(messages.abandoned() == 1);
+    CHECK(messages.add(kOther, fragment(3, 0)) == XBee3Reassembler::Partial);
+    CHECK(messages.abandoned() == 2);
+
+    for (uint8_t i = 1; i < kCount; i++)
+        messages.add(kOther, fragment(3, i));
+    CHECK(matches(messages.message()));
+}
+
+void malformed()
+{
+    ManualClock clock;
+    XBee3Reassembler messages(64);
+    fill(6);
+
+    // Not a fragment at all
+    const uint8_t plain[] = { 1, 2, 3, 4, 5, 6, 7 };
+    lutil::managed_data text(sizeof(plain));
+    memcpy(text.get(), plain, sizeof(plain));
+    CHECK(messages.add(kSender, text) == XBee3Reassembler::Ignored);
+
+    // Bigger than the buffer
+    CHECK(messages.add(kSender, fragment(4, 0)) == XBee3Reassembler::Overrun);
+
+    // Fragments that disagree on the chunk size
+    CHECK(messages.add(kSender, fragment(4, 0, 2, 60)) == XBee3Reassembler::Partial);
+    CHECK(messages.add(kSender, fragment(4, 1, 2, 60, 20)) == XBee3Reassembler::Invalid);
+
+    // A last fragment that leaves the others no whole chunk size
+    CHECK(messages.add(kSender, fragment(7, 2, 3, 50, 15)) == XBee3Reassembler::Invalid);
+
+    // More fragments than the size needs
+    CHECK(messages.add(kSender, fragment(10, 0, 3, 50)) == XBee3Reassembler::Invalid);
+}
+
+/* Nothing may overwrite a message someone still holds */
+void held_message()
+{
+    ManualClock clock;
+    XBee3Reassembler messages;
+    fill(7);
+
+    for (uint8_t i = 0; i < kCount; i++)
+        messages.add(kSender, fragment(8, i));
+
+    {
+        lutil::data_view held = messages.message();
+        CHECK(messages.add(kSender, fragment(9, 0)) == XBee3Reassembler::Overrun);
+        CHECK(matches(held));
+    }
+    CHECK(messages.add(kSender, fragment(9, 0)) == XBee3Reassembler::Partial);
+}
+
+int main()
+{
+    out_of_order();
+    duplicates();
+    timed_out();
+    interrupted();
+    malformed();
+    held_message();
+
+    return check_result();
+}
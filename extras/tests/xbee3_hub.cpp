@@ -0,0 +1,166 @@
+/*
+    Host check of XBee3Hub: every radio gets its turn however busy the
+    others are, nothing is dropped while frames are held, and a radio
+    whose turn is deferred still sends and retries.
+
+        g++ -std=c++14 -O2 -DBUILD_LIB -Isrc extras/tests/xbee3_hub.cpp \
+            src/lu_comm/xbee3_hub.cpp src/lu_comm/xbee3.cpp src/lu_process/process.cpp
+*/
+#include <cstdio>
+#include <cstring>
+
+#include "lutil.h"
+#include "lu_comm/xbee3_hub.h"
+#include "lu_host/mock_stream.h"
+
+#include "check.h"
+
+using lutil::host::LoopbackPair;
+using lutil::host::ManualClock;
+using lutil::host::MockStream;
+
+static const lutil::XBee3Address kAddress{ 0x0013A200, 0x41BDFAFB };
+static const size_t kFrameSize = 54; // 0x10 header and a 40 byte payload
+
+static lutil::XBee3Request request()
+{
+    static uint8_t payload[40];
+    lutil::XBee3Request request(kAddress);
+    request.setPayload(payload, sizeof(payload));
+    return request;
+}
+
+static uint32_t s_queued = 0;
+
+static void frames_queued(void *)
+{
+    s_queued += lutil::Processor::get().current_event()->payload;
+}
+
+/* A flood on one radio and junk on another don't hold up the third */
+void fair_turns()
+{
+    LoopbackPair busy(1 << 16), quiet(1 << 16), noisy(1 << 16);
+    lutil::XBee3 busy_tx, busy_rx, quiet_tx, quiet_rx, noisy_rx;
+    busy_tx.setStream(&busy.a());
+    busy_rx.setStream(&busy.b());
+    quiet_tx.setStream(&quiet.a());
+    quiet_rx.setStream(&quiet.b());
+    noisy_rx.setStream(&noisy.b());
+
+    lutil::XBee3Hub hub;
+    hub.sleep(); // Turns are taken by hand
+    CHECK(hub.add(&busy_rx) == 0);
+    CHECK(hub.add(&quiet_rx) == 1);
+    CHECK(hub.add(&noisy_rx) == 2);
+    hub.when(lutil::XBee3Hub::FrameQueued, frames_queued);
+
+    for (int i = 0; i < 100; i++)
+        busy_tx.send(request());
+    for (int i = 0; i < 3; i++)
+        quiet_tx.send(request());
+
+    // Never makes a frame, each turn only reads its share of it
+    uint8_t junk[4096];
+    memset(junk, 0x55, sizeof(junk));
+    noisy.b().inject(junk, sizeof(junk));
+
+    int from[3] = { 0, 0, 0 };
+    s_queued = 0;
+    for (int turn = 0; turn < 200; turn++) {
+        hub.process();
+        lutil::XBee3HubFrame frame;
+        while (hub.pop(frame)) {
+            from[frame.radio]++;
+            CHECK(frame.response.size() == kFrameSize);
+        }
+        if (turn == 0) {
+            CHECK(from[1] >= 1 && from[0] <= 4);
+            CHECK(noisy.b().available() > 0);
+        }
+        lutil::Processor::get().process();
+    }
+
+    CHECK(from[0] == 100 && from[1] == 3 && from[2] == 0);
+    CHECK(s_queued == 103);
+    for (uint8_t i = 0; i < 3; i++)
+        CHECK(hub.stats(i).overruns == 0);
+    CHECK(noisy.b().available() == 0);
+}
+
+/* Nobody pops: the radio is skipped, not overrun, until there's room */
+void held_frames()
+{
+    LoopbackPair link(1 << 16);
+    lutil::XBee3 tx, rx;
+    tx.setStream(&link.a());
+    rx.setStream(&link.b());
+
+    lutil::XBee3Hub hub;
+    hub.sleep();
+    hub.add(&rx);
+
+    for (int i = 0; i < 20; i++)
+        tx.send(request());
+    for (int turn = 0; turn < 10; turn++)
+        hub.process();
+
+    CHECK(hub.pending() == LUTIL_XBEE3_FRAME_SLOTS - 1);
+    CHECK(hub.stats(0).overruns == 0);
+    CHECK(hub.stats(0).deferred > 0);
+
+    lutil::XBee3HubFrame frame;
+    int popped = 0;
+    for (int turn = 0; turn < 50; turn++) {
+        hub.process();
+        while (hub.pop(frame))
+            popped++;
+    }
+    CHECK(popped == 20);
+}
+
+/* While its turns are deferred the radio keeps retrying its sends */
+void deferred_sends()
+{
+    ManualClock clock;
+    LoopbackPair link(1 << 16);
+    MockStream wire; // What the radio sends, no status ever comes back
+    lutil::XBee3 tx, rx;
+    tx.setStream(&link.a());
+    rx.setStream(&link.b(), &wire);
+    rx.setRetry(2, 100);
+
+    lutil::XBee3Hub hub;
+    hub.sleep();
+    hub.add(&rx);
+
+    for (int i = 0; i < 20; i++)
+        tx.send(request());
+    for (int turn = 0; turn < 10; turn++)
+        hub.process();
+    CHECK(hub.pending() == LUTIL_XBEE3_FRAME_SLOTS - 1);
+
+    lutil::XBee3Request out = request();
+    CHECK(rx.queue(out) != 0);
+    uint8_t frame[64];
+    CHECK(wire.readBytes(frame, sizeof(frame)) == out.frame_size());
+
+    uint32_t deferred = hub.stats(0).deferred;
+    clock.advance_ms(100); // Timed out, back off
+    hub.process();
+    clock.advance_ms(100);
+    hub.process();
+
+    CHECK(hub.stats(0).deferred == deferred + 2);
+    CHECK(wire.readBytes(frame, sizeof(frame)) == out.frame_size());
+    CHECK(rx.inFlight() == 1);
+}
+
+int main()
+{
+    fair_turns();
+    held_frames();
+    deferred_sends();
+
+    return check_result();
+}
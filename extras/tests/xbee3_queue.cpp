@@ -0,0 +1,106 @@
+/*
+    Host check that XBee3::queue() sends every request type as itself:
+    0x11 explicit requests and fragments keep their headers through
+    the send queue, the first transmission and the retries.
+
+        g++ -std=c++14 -O2 -DBUILD_LIB -Isrc extras/tests/xbee3_queue.cpp \
+            src/lu_comm/xbee3.cpp src/lu_comm/xbee3_fragment.cpp
+*/
+#include <cstdio>
+
+#include "lutil.h"
+#include "lu_comm/xbee3.h"
+#include "lu_comm/xbee3_fragment.h"
+#include "lu_host/mock_stream.h"
+
+#include "check.h"
+
+using lutil::host::ManualClock;
+using lutil::host::MockStream;
+
+static const lutil::XBee3Address kAddress{ 0x0013A200, 0x41BDFAFB };
+
+void explicit_request()
+{
+    ManualClock clock;
+    MockStream input, wire; // wire has no peer, what's sent reads back
+
+    lutil::XBee3 xbee;
+    xbee.setStream(&input, &wire);
+    xbee.setRetry(1, 100);
+
+    uint8_t payload[] = { 1, 2, 3 };
+    lutil::XBee3ExplicitRequest request(kAddress, 0xE8, 0xE6, 0x0011, 0xC105);
+    request.setPayload(payload, sizeof(payload));
+
+    uint8_t id = xbee.queue(request);
+    CHECK(id != 0);
+
+    uint8_t frame[64];
+    for (int attempt = 0; attempt < 2; attempt++) {
+        size_t size = wire.readBytes(frame, sizeof(frame));
+        CHECK(size == request.frame_size());
+        if (size != request.frame_size())
+            return;
+        CHECK(lutil::XBee3Frame::validate(frame, size));
+        CHECK(frame[3] == lutil::XBee3Api::ExplicitRequest);
+        CHECK(frame[4] == id);
+        CHECK(frame[15] == 0xE8 && frame[16] == 0xE6);   // Endpoints
+        CHECK(frame[17] == 0x00 && frame[18] == 0x11);   // Cluster
+        CHECK(frame[19] == 0xC1 && frame[20] == 0x05);   // Profile
+        CHECK(frame[size - 2] == 3);
+
+        // No status comes back: time out, back off, send it again
+        clock.advance_ms(100);
+        xbee.poll();
+        clock.advance_ms(100);
+        xbee.poll();
+    }
+}
+
+void fragment_request()
+{
+    ManualClock clock;
+    MockStream input, wire;
+
+    lutil::XBee3 xbee;
+    xbee.setStream(&input, &wire);
+
+    lutil::XBee3FragmentHeader header;
+    header.message = 7;
+    header.index = 1;
+    header.count = 2;
+    header.size = 40;
+
+    uint8_t payload[] = { 9, 9 };
+    lutil::XBee3FragmentRequest request(kAddress, header);
+    request.setPayload(payload, sizeof(payload));
+
+    uint8_t id = xbee.queue(request);
+    CHECK(id != 0);
+
+    uint8_t frame[64];
+    size_t size = wire.readBytes(frame, sizeof(frame));
+    CHECK(size == request.frame_size());
+    if (size != request.frame_size())
+        return;
+    CHECK(lutil::XBee3Frame::validate(frame, size));
+    CHECK(frame[3] == lutil::XBee3Api::TransmitRequest);
+    CHECK(frame[4] == id);
+
+    // The fragment header follows the 0x10 header
+    lutil::managed_data copy(size - 18);
+    memcpy(copy.get(), frame + 17, size - 18);
+    lutil::XBee3FragmentHeader parsed;
+    CHECK(lutil::XBee3FragmentHeader::parse(copy, parsed));
+    CHECK(parsed.message == 7 && parsed.index == 1);
+    CHECK(parsed.count == 2 && parsed.size == 40);
+}
+
+int main()
+{
+    explicit_request();
+    fragment_request();
+
+    return check_result();
+}
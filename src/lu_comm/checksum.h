@@ -0,0 +1,118 @@
+/*
+    8 bit sums over whole buffers (the XBee API checksum is FF minus
+    the low byte of the sum of the frame data).
+
+    sum8() picks the fastest routine for the build:
+
+    - host builds with SSE2 use _mm_sad_epu8, 64 bytes a step
+    - other host builds add a 64 bit word at a time (SWAR)
+    - everything else (the small cores) gets an unrolled byte loop
+
+    The individual routines stay visible for benchmarking.
+*/
+#pragma once
+#include "lutil.h"
+
+#if defined(BUILD_LIB) && defined(__SSE2__)
+#include <emmintrin.h>
+#define LUTIL_SUM8_SSE2
+#endif
+
+namespace lutil {
+namespace checksum {
+
+// Reference: one byte at a time
+inline uint8_t sum_bytes(const uint8_t *data, size_t size) {
+    uint8_t sum = 0;
+    for (size_t i = 0; i < size; i++)
+        sum += data[i];
+    return sum;
+}
+
+// Eight bytes a step into a native int, cheap on 8 bit cores too
+inline uint8_t sum_unrolled(const uint8_t *data, size_t size) {
+    unsigned sum = 0;
+    for (; size >= 8; size -= 8, data += 8) {
+        sum += data[0] + data[1] + data[2] + data[3];
+        sum += data[4] + data[5] + data[6] + data[7];
+    }
+    while (size--)
+        sum += *data++;
+    return (uint8_t)sum;
+}
+
+#ifdef BUILD_LIB
+
+/*
+    Word at a time. The bytes of each word are split over four 16 bit
+    lanes (even and odd bytes added separately) so nothing carries
+    between lanes for up to 128 words, then the lanes are folded.
+*/
+inline uint8_t sum_words(const uint8_t *data, size_t size) {
+    const uint64_t mask = 0x00FF00FF00FF00FFULL;
+    uint64_t total = 0;
+
+    while (size >= 8) {
+        size_t words = size / 8;
+        if (words > 128)
+            words = 128;
+
+        uint64_t lanes = 0;
+        for (size_t i = 0; i < words; i++, data += 8) {
+            uint64_t word;
+            memcpy(&word, data, 8);
+            lanes += (word & mask) + ((word >> 8) & mask);
+        }
+        size -= words * 8;
+
+        total += (lanes & 0xFFFF) + ((lanes >> 16) & 0xFFFF) +
+                 ((lanes >> 32) & 0xFFFF) + (lanes >> 48);
+    }
+
+    while (size--)
+        total += *data++;
+    return (uint8_t)total;
+}
+
+#endif // BUILD_LIB
+
+#ifdef LUTIL_SUM8_SSE2
+
+// _mm_sad_epu8 against zero adds 8 bytes into each 64 bit half
+inline uint8_t sum_sse2(const uint8_t *data, size_t size) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a = zero, b = zero, c = zero, d = zero;
+
+    for (; size >= 64; size -= 64, data += 64) {
+        a = _mm_add_epi64(a, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)data), zero));
+        b = _mm_add_epi64(b, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(data + 16)), zero));
+        c = _mm_add_epi64(c, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(data + 32)), zero));
+        d = _mm_add_epi64(d, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(data + 48)), zero));
+    }
+    for (; size >= 16; size -= 16, data += 16)
+        a = _mm_add_epi64(a, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)data), zero));
+
+    __m128i all = _mm_add_epi64(_mm_add_epi64(a, b), _mm_add_epi64(c, d));
+    all = _mm_add_epi64(all, _mm_unpackhi_epi64(all, all));
+
+    unsigned sum = (unsigned)_mm_cvtsi128_si32(all);
+    while (size--)
+        sum += *data++;
+    return (uint8_t)sum;
+}
+
+#endif // LUTIL_SUM8_SSE2
+
+// Low byte of the sum of every byte in data
+inline uint8_t sum8(const uint8_t *data, size_t size) {
+#if defined(LUTIL_SUM8_SSE2)
+    return sum_sse2(data, size);
+#elif defined(BUILD_LIB)
+    return sum_words(data, size);
+#else
+    return sum_unrolled(data, size);
+#endif
+}
+
+}
+}
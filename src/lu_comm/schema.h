@@ -0,0 +1,422 @@
+/*
+    Compact, endian-stable binary encoding for plain structs, with the
+    layout described once at compile time.
+
+    .. code-block:: cpp
+
+        struct Reading {
+            lutil::Axis accel;
+            float temperature;
+            uint32_t timestamp;
+            int16_t offset;
+        };
+
+        // At global scope, after the struct
+        LU_SCHEMA(Reading,
+            LU_FIELD(accel, Float16),      // 6 bytes rather than 12
+            LU_FIELD(temperature, Raw),    // exact
+            LU_FIELD(timestamp, Varint),   // 1-5 bytes
+            LU_FIELD(offset, ZigZag)       // small +/- values, 1-3 bytes
+        );
+
+        uint8_t buffer[lutil::wire::max_size<Reading>()];
+        size_t size = lutil::wire::encode(reading, buffer, sizeof(buffer));
+        request.setPayload(buffer, size);
+
+        // Receiver, straight from the frame (nothing copied first)
+        Reading reading;
+        if (lutil::wire::decode(response.data(), reading)) { ... }
+
+    Fields go out in the order listed, little endian, with no padding
+    or tags. Both ends have to agree on the schema.
+
+    Codecs:
+
+    - Raw: integers at full width, float/double as IEEE bits
+    - Varint: unsigned integers, 7 bits a byte
+    - ZigZag: signed integers as varints (-1 is one byte, not ten)
+    - Float16: floats as IEEE half precision (~3 significant digits)
+    - Nested: another struct with its own LU_SCHEMA
+
+    Axis fields take any float codec and apply it to x, y and z.
+*/
+#pragma once
+#include "lutil.h"
+#include "lu_math/axis.h"
+#include "lu_memory/managed_ptr.h"
+
+namespace lutil {
+namespace wire {
+
+/* Bounds checked output. Stops (and stays failed) once it's full. */
+struct Writer {
+    Writer(uint8_t *buffer, size_t capacity)
+        : ptr(buffer)
+        , end(buffer + capacity)
+        , ok(buffer != nullptr)
+    {}
+
+    void put(uint8_t value) {
+        if (ptr < end)
+            *ptr++ = value;
+        else
+            ok = false;
+    }
+
+    uint8_t *ptr;
+    uint8_t *end;
+    bool ok;
+};
+
+/* Bounds checked input. Reads past the end give 0 and fail. */
+struct Reader {
+    Reader(const uint8_t *buffer, size_t size)
+        : ptr(buffer)
+        , end(buffer + size)
+        , ok(buffer != nullptr || size == 0)
+    {}
+
+    uint8_t get() {
+        if (ptr < end)
+            return *ptr++;
+        ok = false;
+        return 0;
+    }
+
+    const uint8_t *ptr;
+    const uint8_t *end;
+    bool ok;
+};
+
+// --------------------------------------------------------------------
+// HALF FLOATS
+
+// Round to nearest even, out of range goes to infinity
+inline uint16_t float_to_half(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    uint32_t raw_exponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    int32_t exponent = (int32_t)raw_exponent - 127 + 15;
+
+    if (raw_exponent == 0xFF) // Inf and NaN
+        return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+    if (exponent >= 31)
+        return sign | 0x7C00;
+
+    if (exponent <= 0) {
+        // Subnormal (or too small for even that)
+        if (exponent < -10)
+            return sign;
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t middle = 1u << (shift - 1);
+        if (rest > middle || (rest == middle && (half & 1)))
+            half++;
+        return (uint16_t)(sign | half);
+    }
+
+    uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++; // May carry into the exponent, which is still right
+    return (uint16_t)(sign | half);
+}
+
+inline float half_to_float(uint16_t half) {
+    uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+    uint32_t bits;
+
+    if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign;
+        } else {
+            // Subnormal, normalise it
+            exponent = 127 - 15 + 1;
+            while (!(mantissa & 0x400)) {
+                mantissa <<= 1;
+                exponent--;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+        }
+    }
+    else if (exponent == 31) {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    }
+    else {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// --------------------------------------------------------------------
+// CODECS
+
+struct Raw {
+    template<typename T>
+    static constexpr size_t max_size() { return sizeof(T); }
+
+    template<typename T>
+    static void put(Writer &out, T value) {
+        for (size_t i = 0; i < sizeof(T); i++)
+            out.put((uint8_t)((uint64_t)value >> (8 * i)));
+    }
+
+    template<typename T>
+    static void get(Reader &in, T &value) {
+        uint64_t bits = 0;
+        for (size_t i = 0; i < sizeof(T); i++)
+            bits |= (uint64_t)in.get() << (8 * i);
+        value = (T)bits;
+    }
+
+    static void put(Writer &out, bool value) { out.put(value ? 1 : 0); }
+    static void get(Reader &in, bool &value) { value = in.get() != 0; }
+
+    static void put(Writer &out, float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        put(out, bits);
+    }
+
+    static void get(Reader &in, float &value) {
+        uint32_t bits;
+        get(in, bits);
+        memcpy(&value, &bits, sizeof(value));
+    }
+
+    static void put(Writer &out, double value) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        put(out, bits);
+    }
+
+    static void get(Reader &in, double &value) {
+        uint64_t bits;
+        get(in, bits);
+        memcpy(&value, &bits, sizeof(value));
+    }
+};
+
+struct Varint {
+    template<typename T>
+    static constexpr size_t max_size() { return (sizeof(T) * 8 + 6) / 7; }
+
+    template<typename T>
+    static void put(Writer &out, T value) {
+        // Only T's own bits (a negative int shouldn't take 10 bytes)
+        uint64_t bits = (uint64_t)value;
+        if (sizeof(T) < 8)
+            bits &= ((uint64_t)1 << (8 * sizeof(T))) - 1;
+        while (bits >= 0x80) {
+            out.put((uint8_t)(bits | 0x80));
+            bits >>= 7;
+        }
+        out.put((uint8_t)bits);
+    }
+
+    template<typename T>
+    static void get(Reader &in, T &value) {
+        uint64_t bits = 0;
+        for (size_t shift = 0; shift < sizeof(T) * 8; shift += 7) {
+            uint8_t byte = in.get();
+            bits |= (uint64_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                value = (T)bits;
+                return;
+            }
+        }
+        in.ok = false; // Longer than T can hold
+    }
+};
+
+struct ZigZag {
+    template<typename T>
+    static constexpr size_t max_size() { return Varint::max_size<T>(); }
+
+    template<typename T>
+    static void put(Writer &out, T value) {
+        int64_t wide = (int64_t)value;
+        Varint::put(out, ((uint64_t)wide << 1) ^ (uint64_t)(wide >> 63));
+    }
+
+    template<typename T>
+    static void get(Reader &in, T &value) {
+        uint64_t bits = 0;
+        Varint::get(in, bits);
+        value = (T)(int64_t)((bits >> 1) ^ (~(bits & 1) + 1));
+    }
+};
+
+struct Float16 {
+    template<typename T>
+    static constexpr size_t max_size() { return 2; }
+
+    static void put(Writer &out, float value) {
+        Raw::put(out, float_to_half(value));
+    }
+
+    static void get(Reader &in, float &value) {
+        uint16_t half;
+        Raw::get(in, half);
+        value = half_to_float(half);
+    }
+};
+
+// Specialised by LU_SCHEMA
+template<typename T>
+struct Schema;
+
+struct Nested {
+    template<typename T>
+    static constexpr size_t max_size() { return Schema<T>::fields::max_size(); }
+
+    template<typename T>
+    static void put(Writer &out, const T &value) {
+        Schema<T>::fields::put(out, value);
+    }
+
+    template<typename T>
+    static void get(Reader &in, T &value) {
+        Schema<T>::fields::get(in, value);
+    }
+};
+
+// --------------------------------------------------------------------
+// FIELDS
+
+/* How many scalars make up a T (Axis is three floats) */
+template<typename T>
+struct Parts {
+    static constexpr size_t count = 1;
+
+    template<typename CODEC>
+    static void put(Writer &out, const T &value) { CODEC::put(out, value); }
+
+    template<typename CODEC>
+    static void get(Reader &in, T &value) { CODEC::get(in, value); }
+
+    template<typename CODEC>
+    static constexpr size_t max_size() { return CODEC::template max_size<T>(); }
+};
+
+template<>
+struct Parts<Axis> {
+    template<typename CODEC>
+    static void put(Writer &out, const Axis &value) {
+        CODEC::put(out, value.x);
+        CODEC::put(out, value.y);
+        CODEC::put(out, value.z);
+    }
+
+    template<typename CODEC>
+    static void get(Reader &in, Axis &value) {
+        CODEC::get(in, value.x);
+        CODEC::get(in, value.y);
+        CODEC::get(in, value.z);
+    }
+
+    template<typename CODEC>
+    static constexpr size_t max_size() { return 3 * CODEC::template max_size<float>(); }
+};
+
+template<typename S, typename T, T S::*MEMBER, typename CODEC>
+struct Field {
+    static void put(Writer &out, const S &value) {
+        Parts<T>::template put<CODEC>(out, value.*MEMBER);
+    }
+
+    static void get(Reader &in, S &value) {
+        Parts<T>::template get<CODEC>(in, value.*MEMBER);
+    }
+
+    static constexpr size_t max_size() {
+        return Parts<T>::template max_size<CODEC>();
+    }
+};
+
+template<typename... FIELDS>
+struct Fields;
+
+template<>
+struct Fields<> {
+    template<typename S> static void put(Writer &, const S &) {}
+    template<typename S> static void get(Reader &, S &) {}
+    static constexpr size_t max_size() { return 0; }
+};
+
+template<typename FIELD, typename... REST>
+struct Fields<FIELD, REST...> {
+    template<typename S>
+    static void put(Writer &out, const S &value) {
+        FIELD::put(out, value);
+        Fields<REST...>::put(out, value);
+    }
+
+    template<typename S>
+    static void get(Reader &in, S &value) {
+        FIELD::get(in, value);
+        Fields<REST...>::get(in, value);
+    }
+
+    static constexpr size_t max_size() {
+        return FIELD::max_size() + Fields<REST...>::max_size();
+    }
+};
+
+// --------------------------------------------------------------------
+// ENCODE / DECODE
+
+// Buffer size that fits any value of T
+template<typename T>
+constexpr size_t max_size() {
+    return Schema<T>::fields::max_size();
+}
+
+// Bytes written, 0 when capacity is too small
+template<typename T>
+size_t encode(const T &value, uint8_t *buffer, size_t capacity) {
+    Writer out(buffer, capacity);
+    Schema<T>::fields::put(out, value);
+    return out.ok ? (size_t)(out.ptr - buffer) : 0;
+}
+
+// False when data is too short (value is then partly filled)
+template<typename T>
+bool decode(const uint8_t *data, size_t size, T &value) {
+    Reader in(data, size);
+    Schema<T>::fields::get(in, value);
+    return in.ok;
+}
+
+template<typename T>
+bool decode(const data_view &data, T &value) {
+    return decode(data.get(), data.size(), value);
+}
+
+}
+}
+
+/*
+    Declare the wire layout of TYPE. Use at global scope, listing
+    LU_FIELD(member, Codec) in the order they go on the wire.
+*/
+#define LU_SCHEMA(TYPE, ...)                \
+    namespace lutil { namespace wire {      \
+    template<> struct Schema<TYPE> {        \
+        typedef TYPE schema_type;           \
+        typedef Fields<__VA_ARGS__> fields; \
+    };                                      \
+    } }
+
+#define LU_FIELD(MEMBER, CODEC) \
+    lutil::wire::Field<schema_type, decltype(schema_type::MEMBER), &schema_type::MEMBER, lutil::wire::CODEC>
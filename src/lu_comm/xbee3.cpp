@@ -1,138 +1,386 @@
 #include "xbee3.h"
 
 #define kStartByte 0x7E
-#define kApiIndex 3
-
-// Allow up to 65520 byte payload (should never get close)
-#define kMaxFrameDataSize 0xFFF0
 
 namespace lutil
 {
 
-XBee3Request::XBee3Request(const XBee3Address &address)
-    : _address(address)
-    , _payload()
+// Wrap safe "has time reached deadline"
+static bool reached(uint32_t now, uint32_t deadline)
+{
+    return (int32_t)(now - deadline) >= 0;
+}
+
+// --------------------------------------------------------------------
+// AP=2 escaping
+
+const uint8_t XBee3Escape::kTable[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x00
+    0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x10
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x20
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x30
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x40
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x50
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x60
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0,  // 0x70
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x80
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x90
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0xA0
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0xB0
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0xC0
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0xD0
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0xE0
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0xF0
+};
+
+size_t XBee3Escape::write(Print &out, const uint8_t *data, size_t size)
+{
+    const uint8_t *end = data + size;
+    size_t written = 0;
+
+    while (data < end)
+    {
+        // Everything up to the next special byte goes out in one go
+        const uint8_t *run = data;
+        while (data < end && !kTable[*data])
+            data++;
+        if (data != run)
+            written += out.write(run, data - run);
+
+        if (data < end)
+        {
+            uint8_t escaped[2] = { kEscape, (uint8_t)(*data++ ^ 0x20) };
+            written += out.write(escaped, 2);
+        }
+    }
+    return written;
+}
+
+size_t XBee3Unescaper::decode(uint8_t *data, size_t size, size_t &consumed)
+{
+    const uint8_t *in = data;
+    const uint8_t *end = data + size;
+    uint8_t *out = data;
+
+    // The escape byte ended the last buffer
+    if (_pending && in < end && *in != kStartByte)
+    {
+        *out++ = *in++ ^ 0x20;
+        _pending = false;
+    }
+
+    while (in < end)
+    {
+        const uint8_t *run = in;
+        while (in < end && !XBee3Escape::kTable[*in])
+            in++;
+        if (in != run)
+        {
+            memmove(out, run, in - run);
+            out += in - run;
+        }
+        if (in == end || *in == kStartByte)
+            break;
+
+        if (*in++ == XBee3Escape::kEscape)
+        {
+            if (in == end)
+            {
+                _pending = true;
+                break;
+            }
+            if (*in == kStartByte)
+                break; // Cut short, the frame will fail its checksum
+            *out++ = *in++ ^ 0x20;
+        }
+        // else raw XON/XOFF, flow control rather than data
+    }
+
+    consumed = in - data;
+    return out - data;
+}
+
+// --------------------------------------------------------------------
+
+XBee3Frame::XBee3Frame()
+    : _payload()
+    , _frame_id(0)
 {}
 
-void XBee3Request::setPayload(uint8_t *payload, uint16_t size)
+void XBee3Frame::setPayload(uint8_t *payload, uint16_t size)
 {
-    size_t s = size;
-    _payload.reset(payload, s); // copies data
+    managed_data copy;
+    copy.reset(payload, size); // copies data
+    _payload = copy;
 }
 
-void XBee3Request::setPayload(const managed_data &payload)
+void XBee3Frame::setPayload(const data_view &payload)
 {
     _payload = payload;
 }
 
+static uint8_t *put_u16(uint8_t *ptr, uint16_t value)
+{
+    *ptr++ = (value >> 8) & 0xFF;
+    *ptr++ = value & 0xFF;
+    return ptr;
+}
+
+static uint8_t *put_address(uint8_t *ptr, const XBee3Address &address)
+{
+    // Address High
+    *ptr++ = (address.high >> 24) & 0xFF;
+    *ptr++ = (address.high >> 16) & 0xFF;
+    *ptr++ = (address.high >> 8) & 0xFF;
+    *ptr++ = (address.high & 0xFF);
+
+    // Address Low
+    *ptr++ = (address.low >> 24) & 0xFF;
+    *ptr++ = (address.low >> 16) & 0xFF;
+    *ptr++ = (address.low >> 8) & 0xFF;
+    *ptr++ = address.low & 0xFF;
+    return ptr;
+}
+
+static uint8_t payload_sum(const data_view &payload)
+{
+    return checksum::sum8(payload.get(), payload.size());
+}
+
 /**
- * Header:
- * 
+ * Every frame:
+ *
  * |   byte   |   value    |                 Detail                  |
  * +----------+------------+-----------------------------------------+
  * |     0    |     7E     | Always 7E                               |
- * |    1-2   |   XX  XX   | Full size (at _least_ 00 0E)            |
- * |     3    |     10     | API Frame type (currently always 10)    |
- * |     4    |     00     | Frame ID - don't request reponse        |
- * |    5-12  | 64bit ADDR | Address of XBee to send this request to |
- * |   13-14  |    FF FE   | FF FE because we're only using 64 bit   |
- * |    15    |     00     | Broadcast radius (adjust?)              |
- * |    16    |     00     | Options (currently not used)            |
- * | 17-(N-1) |     --     | RF Data - proper payload                |
+ * |    1-2   |   XX  XX   | Frame data size (header through payload)|
+ * |  3-(H-1) |     --     | Frame header, API id first              |
+ * | H-(N-1)  |     --     | Payload                                 |
  * |   (N-1)  |     XX     | Checksum                                |
  * +----------+------------+-----------------------------------------+
- * 
+ *
  * The checksum is:
  *      FF minus 8 bit sum of bytes between length and checksum field
  */
-RawData XBee3Request::data() const
+uint16_t XBee3Frame::_header(uint8_t *output, uint8_t &sum) const
 {
-    uint16_t headerSize = 4; // 0, 1-2, N-1
+    uint16_t header = _frame_header(output + 3);
+    uint16_t frameSize = header + (uint16_t)_payload.size();
 
-    // 0x000E is the smallest payload (with addresses, frame ID, etc)
-    uint16_t bufferSize = 0x000E + (uint16_t)_payload.size() - 1;
+    output[0] = kStartByte; // Start Delimiter
+    put_u16(output + 1, frameSize); // Length
 
-    uint8_t *output = new uint8_t[bufferSize + headerSize];
-    uint8_t *ptr = output;
+    sum = checksum::sum8(output + 3, header);
+    return header + 3;
+}
+
+size_t XBee3Frame::frame_size() const
+{
+    uint8_t header[kMaxHeaderSize];
+    uint8_t sum;
+    return _header(header, sum) + _payload.size() + 1;
+}
 
-    // -- HEADER -- //
-    *ptr++ = 0x7E; // Start Delimiter
+size_t XBee3Frame::serialize_into(uint8_t *buffer, size_t capacity) const
+{
+    uint8_t header[kMaxHeaderSize];
+    uint8_t sum;
+    uint16_t headerSize = _header(header, sum);
 
-    *ptr++ = (bufferSize >> 8) & 0xFF; // Length high
-    *ptr++ = bufferSize & 0xFF; // Length low
+    size_t size = headerSize + _payload.size() + 1;
+    if (!buffer || capacity < size)
+        return 0;
 
-    // -- FRAME DATA -- //
-    *ptr++ = 0x10; // API Frame Type
+    memcpy(buffer, header, headerSize);
 
-    *ptr++ = 0x00; // Frame ID
+    // -- PAYLOAD -- //
+    if (_payload.size())
+        memcpy(buffer + headerSize, _payload.get(), _payload.size());
+    sum += payload_sum(_payload);
 
-    // Address High
-    *ptr++ = (_address.high >> 24) & 0xFF;
-    *ptr++ = (_address.high >> 16) & 0xFF;
-    *ptr++ = (_address.high >> 8) & 0xFF;
-    *ptr++ = (_address.high & 0xFF);
+    // -- CHECKSUM -- //
+    buffer[size - 1] = (uint8_t)0xFF - sum;
+    return size;
+}
 
-    // Address Low
-    *ptr++ = (_address.low >> 24) & 0xFF;
-    *ptr++ = (_address.low >> 16) & 0xFF;
-    *ptr++ = (_address.low >> 8) & 0xFF;
-    *ptr++ = _address.low & 0xFF;
+size_t XBee3Frame::write_to(Print &out, bool escaped) const
+{
+    uint8_t header[kMaxHeaderSize];
+    uint8_t sum;
+    uint16_t headerSize = _header(header, sum);
+    sum += payload_sum(_payload);
+    uint8_t checksum = 0xFF - sum;
 
-    *ptr++ = 0xFF; // 16bit addr high
-    *ptr++ = 0xFE; // 16bit addr low
+    if (escaped)
+    {
+        // Everything but the start delimiter
+        size_t written = out.write(header, 1);
+        written += XBee3Escape::write(out, header + 1, headerSize - 1);
+        written += XBee3Escape::write(out, _payload.get(), _payload.size());
+        written += XBee3Escape::write(out, &checksum, 1);
+        return written;
+    }
 
-    *ptr++ = 0x00; // Broadcast Radius
+    size_t written = out.write(header, headerSize);
+    if (_payload.size())
+        written += out.write(_payload.get(), _payload.size());
 
-    *ptr++ = 0x00; // Options
+    written += out.write(checksum);
+    return written;
+}
 
-    // -- PAYLOAD -- //
-    memcpy(ptr, _payload.get(), _payload.size());
-    ptr += _payload.size() - 1;
+bool XBee3Frame::validate(const uint8_t *frame, size_t size)
+{
+    if (!frame || size < 5 || frame[0] != kStartByte)
+        return false;
 
-    // -- CHECKSUM -- //
-    uint8_t checksum = 0;
-    for (uint8_t *i = (output + headerSize - 1); i != ptr; i++)
-        checksum += *i;
-    *ptr = (uint8_t)0xFF - checksum;
+    size_t length = ((size_t)frame[1] << 8) | frame[2];
+    if (length + 4 != size)
+        return false;
+
+    // Frame data plus its checksum sums to FF
+    return checksum::sum8(frame + 3, length + 1) == 0xFF;
+}
 
-    return { output, (uint16_t)(bufferSize + headerSize) };
+RawData XBee3Frame::data() const
+{
+    size_t size = frame_size();
+    uint8_t *output = new uint8_t[size];
+    serialize_into(output, size);
+    return { output, (uint16_t)size };
 }
 
 // --------------------------------------------------------------------
 
-Xbee3Response::Xbee3Response()
-    : _origin({0, 0})
-    , _api_id(0)
-    , _checksum(0)
-    , _size(0)
+XBee3Request::XBee3Request(const XBee3Address &address)
+    : XBee3Frame()
+    , _address(address)
+{}
+
+XBee3Request::XBee3Request()
+    : XBee3Frame()
+    , _address({0, 0})
+{}
+
+/**
+ * 0x10 frame header:
+ *
+ * |   byte   |   value    |                 Detail                  |
+ * +----------+------------+-----------------------------------------+
+ * |     0    |     10     | API Frame type                          |
+ * |     1    |     00     | Frame ID - 00 doesn't request a reponse |
+ * |    2-9   | 64bit ADDR | Address of XBee to send this request to |
+ * |   10-11  |    FF FE   | FF FE because we're only using 64 bit   |
+ * |    12    |     00     | Broadcast radius (adjust?)              |
+ * |    13    |     00     | Options (currently not used)            |
+ * +----------+------------+-----------------------------------------+
+ */
+uint16_t XBee3Request::_frame_header(uint8_t *output) const
+{
+    uint8_t *ptr = output;
+    *ptr++ = XBee3Api::TransmitRequest; // API Frame Type
+    *ptr++ = _frame_id; // Frame ID
+    ptr = put_address(ptr, _address);
+    ptr = put_u16(ptr, 0xFFFE); // 16bit addr
+    *ptr++ = 0x00; // Broadcast Radius
+    *ptr++ = 0x00; // Options
+    return (uint16_t)(ptr - output);
+}
+
+XBee3ExplicitRequest::XBee3ExplicitRequest(
+    const XBee3Address &address,
+    uint8_t source_endpoint,
+    uint8_t destination_endpoint,
+    uint16_t cluster,
+    uint16_t profile)
+    : XBee3Request(address)
+    , _source_endpoint(source_endpoint)
+    , _destination_endpoint(destination_endpoint)
+    , _cluster(cluster)
+    , _profile(profile)
+{}
+
+uint16_t XBee3ExplicitRequest::_frame_header(uint8_t *output) const
 {
+    uint8_t *ptr = output;
+    *ptr++ = XBee3Api::ExplicitRequest; // API Frame Type
+    *ptr++ = _frame_id; // Frame ID
+    ptr = put_address(ptr, _address);
+    ptr = put_u16(ptr, 0xFFFE); // 16bit addr
+    *ptr++ = _source_endpoint;
+    *ptr++ = _destination_endpoint;
+    ptr = put_u16(ptr, _cluster);
+    ptr = put_u16(ptr, _profile);
+    *ptr++ = 0x00; // Broadcast Radius
+    *ptr++ = 0x00; // Options
+    return (uint16_t)(ptr - output);
 }
 
-bool Xbee3Response::isValid() const
+XBee3AtCommand::XBee3AtCommand(const char *command, uint8_t frame_id)
+    : XBee3Frame()
+{
+    _command[0] = command[0];
+    _command[1] = command[0] ? command[1] : '\0';
+    _frame_id = frame_id;
+}
+
+uint16_t XBee3AtCommand::_frame_header(uint8_t *output) const
+{
+    output[0] = XBee3Api::AtCommand;
+    output[1] = _frame_id;
+    output[2] = (uint8_t)_command[0];
+    output[3] = (uint8_t)_command[1];
+    return 4;
+}
+
+XBee3FrameCopy::XBee3FrameCopy()
+    : XBee3Frame()
+    , _header_size(0)
+{}
+
+XBee3FrameCopy::XBee3FrameCopy(const XBee3Frame &frame)
+    : XBee3Frame()
 {
-    return _payload.get();
+    _frame_id = frame._frame_id;
+    _payload = frame._payload;
+    _header_size = (uint8_t)frame._frame_header(_header);
 }
 
-void Xbee3Response::add_checksum(uint8_t cs)
+/**
+ * Every frame we build carries its frame id right after the API id,
+ * so that's the one byte we patch.
+ */
+uint16_t XBee3FrameCopy::_frame_header(uint8_t *output) const
 {
-    _checksum += cs;
+    memcpy(output, _header, _header_size);
+    if (_header_size > 1)
+        output[1] = _frame_id;
+    return _header_size;
 }
 
-void Xbee3Response::set_api_id(uint8_t id)
+// --------------------------------------------------------------------
+
+Xbee3Response::Xbee3Response()
+    : _origin({0, 0})
+    , _api_id(0)
+    , _checksum(0)
+    , _size(0)
 {
-    _api_id = id;
 }
 
-void Xbee3Response::add_size(uint16_t s)
+bool Xbee3Response::isValid() const
 {
-    _size += s;
+    return _size > 0;
 }
 
-void Xbee3Response::allocate()
+void Xbee3Response::set_frame(const data_view &frame, uint8_t checksum)
 {
-    // Assume we have the size already
-    uint8_t *newData = new uint8_t[_size];
-    _payload.reset(newData, _size);
+    _api_id = frame[0];
+    _size = (uint16_t)frame.size();
+    _checksum = checksum;
+
+    // Everything after the API id
+    _payload = frame.slice(1);
 }
 
 XBee3Address Xbee3Response::sender() const
@@ -152,42 +400,116 @@ XBee3Address Xbee3Response::sender() const
     return addr;
 }
 
-managed_data Xbee3Response::data() const
+data_view Xbee3Response::data() const
 {
-    // Account for the address, 16bit addr, api id
-    static size_t s_offset = (sizeof(uint32_t) * 2) + \
-                             sizeof(uint16_t) + \
-                             sizeof(uint8_t);
+    // Everything ahead of the data, after the api id
+    switch (_api_id)
+    {
+    case XBee3Api::ReceivePacket:
+        return _payload.slice(11); // 64bit, 16bit addr, options
+    case XBee3Api::ExplicitRx:
+        return _payload.slice(17); // + endpoints, cluster, profile
+    case XBee3Api::AtResponse:
+        return _payload.slice(4); // frame id, command, status
+    default:
+        return _payload;
+    }
+}
+
+// --------------------------------------------------------------------
 
-    managed_data content;
+static uint16_t get_u16(const data_view &data, size_t index)
+{
+    return (uint16_t)(((uint16_t)data[index] << 8) | data[index + 1]);
+}
 
-    // Data
-    uint8_t *c = new uint8_t[
-        _payload.size() - s_offset
-    ];
-    size_t realSize = _payload.size() - s_offset;
+bool XBee3RxPacket::parse(const Xbee3Response &response, XBee3RxPacket &out)
+{
+    const data_view &p = response.payload();
+    if (response.apiId() != kApiId || p.size() < 11)
+        return false;
+
+    out.sender = response.sender();
+    out.network = get_u16(p, 8);
+    out.options = p[10];
+    out.data = p.slice(11);
+    return true;
+}
 
-    memcpy(
-        c,
-        _payload.get() + s_offset,
-        realSize
-    );
+bool XBee3ExplicitRx::parse(const Xbee3Response &response, XBee3ExplicitRx &out)
+{
+    const data_view &p = response.payload();
+    if (response.apiId() != kApiId || p.size() < 17)
+        return false;
+
+    out.sender = response.sender();
+    out.network = get_u16(p, 8);
+    out.source_endpoint = p[10];
+    out.destination_endpoint = p[11];
+    out.cluster = get_u16(p, 12);
+    out.profile = get_u16(p, 14);
+    out.options = p[16];
+    out.data = p.slice(17);
+    return true;
+}
 
-    content.take(c, realSize);
-    return content;
+bool XBee3TxStatus::parse(const Xbee3Response &response, XBee3TxStatus &out)
+{
+    const data_view &p = response.payload();
+    if (response.apiId() != kApiId || p.size() < 6)
+        return false;
+
+    out.frame_id = p[0];
+    out.network = get_u16(p, 1);
+    out.retries = p[3];
+    out.delivery = p[4];
+    out.discovery = p[5];
+    return true;
 }
 
-uint8_t &Xbee3Response::operator[] (uint16_t pos)
+bool XBee3AtResponse::parse(const Xbee3Response &response, XBee3AtResponse &out)
 {
-    return _payload[pos];
+    const data_view &p = response.payload();
+    if (response.apiId() != kApiId || p.size() < 4)
+        return false;
+
+    out.frame_id = p[0];
+    out.command[0] = (char)p[1];
+    out.command[1] = (char)p[2];
+    out.status = p[3];
+    out.data = p.slice(4);
+    return true;
 }
 
 // --------------------------------------------------------------------
 
 XBee3::XBee3()
-    : _pos(0)
+    : _slot(0)
+    , _chunk_pos(0)
+    , _chunk_size(0)
+    , _raw_pos(0)
+    , _raw_size(0)
+    , _escaped(false)
+    , _read_budget(0)
+    , _state(WaitStart)
+    , _length(0)
+    , _filled(0)
+    , _next_timeout(0)
     , _timeout(1000)
+    , _order(0)
+    , _frame_id(0)
+    , _window(1)
+    , _retries(2)
+    , _retry_timeout(1000)
+    , _delivery(nullptr)
+    , _delivery_data(nullptr)
 {
+    for (uint8_t i = 0; i < LUTIL_XBEE3_SEND_QUEUE; i++)
+        _outgoing[i].state = Free;
+
+    // The only allocations we make, everything is parsed in place
+    for (uint8_t i = 0; i < LUTIL_XBEE3_FRAME_SLOTS; i++)
+        _slots[i] = managed_data(LUTIL_XBEE3_MAX_FRAME);
 }
 
 Stream *XBee3::stream() const
@@ -201,13 +523,12 @@ void XBee3::setStream(Stream *input, Stream *output)
     _output_stream = output ? output : input;
 }
 
-void XBee3::send(const XBee3Request &request)
+void XBee3::send(const XBee3Frame &request)
 {
     if (!_output_stream)
         return;
 
-    RawData d = request.data();
-    _output_stream->write(d.data, d.size);
+    request.write_to(*_output_stream, _escaped);
 }
 
 Xbee3Response::Status XBee3::poll()
@@ -215,99 +536,424 @@ Xbee3Response::Status XBee3::poll()
     if (!_stream)
         return Xbee3Response::Invalid;
 
+    // Let go of the last frame. Unless the application kept a
+    // copy of the response, its slot is free again.
     if (_latest_response.isValid())
         _latest_response = Xbee3Response();
 
-    while (_stream->available() > 0)
-    {
-        uint8_t b = _stream->read();
+    _service_queue();
 
-        if (_pos == 0)
+    size_t budget = _read_budget ? _read_budget : (size_t)-1;
+    while (true)
+    {
+        if (_chunk_pos == _chunk_size)
         {
-            _next_timeout = millis() + _timeout;
-            _working_response = Xbee3Response();
-
-            if (b != kStartByte)
-                continue; // Not a valid start
+            if (_raw_pos == _raw_size)
+            {
+                // Pull in as much as is waiting (up to a chunk)
+                int available = _stream->available();
+                if (available <= 0 || budget == 0)
+                    break;
+
+                size_t want = (size_t)available < sizeof(_chunk) ? (size_t)available : sizeof(_chunk);
+                if (want > budget)
+                    want = budget;
+                _raw_size = (uint16_t)_stream->readBytes(_chunk, want);
+                _raw_pos = 0;
+                _chunk_pos = 0;
+                _chunk_size = 0;
+                if (_raw_size == 0)
+                    break;
+                budget -= _raw_size;
+
+                if (!_escaped)
+                {
+                    _chunk_size = _raw_size;
+                    _raw_pos = _raw_size;
+                }
+            }
 
-            _pos++;
-            continue;
+            if (_escaped)
+            {
+                Xbee3Response::Status status = _unescape();
+                if (status != Xbee3Response::InProgress)
+                    return status;
+                continue;
+            }
         }
 
-		// Checksum!
-		if (_pos >= kApiIndex)
+        Xbee3Response::Status status = _parse();
+        if (status == Xbee3Response::Valid &&
+            _latest_response.apiId() == XBee3Api::TransmitStatus)
         {
-			_working_response.add_checksum(b);
+            XBee3TxStatus tx;
+            if (XBee3TxStatus::parse(_latest_response, tx))
+                _match_status(tx);
         }
+        if (status != Xbee3Response::InProgress)
+            return status;
+    }
+
+    if (_state != WaitStart && reached(millis(), _next_timeout))
+    {
+        // We've timed out this request. Reset
+        _state = WaitStart;
+        return Xbee3Response::Timeout;
+    }
+
+    if (_state != WaitStart)
+        return Xbee3Response::InProgress;
+    else
+        return Xbee3Response::None;
+}
+
+/**
+ * Run the buffered chunk through the frame state machine. Returns
+ * as soon as something worth reporting happens (leaving the rest of
+ * the chunk for the next poll()) or InProgress once it's used up.
+ */
+Xbee3Response::Status XBee3::_parse()
+{
+    const uint8_t *ptr = _chunk + _chunk_pos;
+    const uint8_t *end = _chunk + _chunk_size;
+    Xbee3Response::Status status = Xbee3Response::InProgress;
 
-        switch (_pos)
+    while (ptr < end && status == Xbee3Response::InProgress)
+    {
+        switch (_state)
         {
-        case 1:
+        case WaitStart:
         {
-            // length high
-            _working_response.add_size((uint16_t)b << 8);
+            // Jump straight to the next delimiter
+            const uint8_t *start = (const uint8_t *)memchr(ptr, kStartByte, end - ptr);
+            if (!start)
+            {
+                ptr = end;
+                break;
+            }
+            ptr = start + 1;
+            _next_timeout = millis() + _timeout;
+            _state = LengthHigh;
             break;
         }
-        case 2:
+        case LengthHigh:
+            _length = (uint16_t)(*ptr++) << 8;
+            _state = LengthLow;
+            break;
+
+        case LengthLow:
         {
-            // length low
-            _working_response.add_size(b);
+            _length |= *ptr++;
+            _filled = 0;
 
-            // Once we have the payload size, we can allocate
-            _working_response.allocate();
+            if (_length == 0)
+            {
+                // Can't even hold an API id
+                _state = WaitStart;
+                status = Xbee3Response::Invalid;
+            }
+            else if (_length > LUTIL_XBEE3_MAX_FRAME)
+            {
+                _state = Skip;
+                status = Xbee3Response::TooLarge;
+            }
+            else if (!_claim_slot())
+            {
+                _state = Skip;
+                status = Xbee3Response::Overrun;
+            }
+            else
+            {
+                _state = FrameData;
+            }
             break;
         }
-        case 3:
+        case FrameData:
         {
-            _working_response.set_api_id(b);
-            uint16_t workpos = _pos - (kApiIndex + 1);
-            _working_response[workpos] = b;
+            // Copy as much of the frame as this chunk holds
+            uint16_t take = (uint16_t)(_length - _filled);
+            if ((size_t)(end - ptr) < take)
+                take = (uint16_t)(end - ptr);
+
+            memcpy(_slots[_slot].get() + _filled, ptr, take);
+            _filled += take;
+            ptr += take;
+
+            if (_filled == _length)
+                _state = Checksum;
             break;
         }
-        default:
+        case Checksum:
         {
-            // Here, we start the actual payload collection
-            if (_pos > kMaxFrameDataSize)
+            // The whole frame is in, sum it in one go
+            _state = WaitStart;
+            uint8_t checksum = checksum::sum8(_slots[_slot].get(), _length) + *ptr++;
+            if (checksum != (uint8_t)0xFF)
             {
-                // Invalid payload (too large!)
-                _pos = 0;
-                return Xbee3Response::TooLarge;
+                status = Xbee3Response::Invalid;
+                break;
             }
 
-            // We have new data to punch into the managed
-            // data container of our working response
-            uint16_t working_position = _pos - (kApiIndex + 1);
-            _working_response[working_position] = b;
-
-            if (_pos >= (uint16_t)(_working_response.size() + kApiIndex - 1))
-            {
-                // We're at the end of the packet. Check
-                // on the checksum
-                if (_working_response.checksum() == (uint8_t)0xFF)
-                {
-                    // We have a valid payload!
-                    _latest_response = _working_response;
-                    return Xbee3Response::Valid;
-                }
-                _pos = 0; // Even an invalid payload needs to be reset
-            }
+            // Hand the frame out in place
+            _latest_response.set_frame(_slots[_slot].slice(0, _length), checksum);
+            status = Xbee3Response::Valid;
+            break;
+        }
+        case Skip:
+        {
+            // The frame data plus its checksum
+            uint32_t left = (uint32_t)_length + 1 - _filled;
+            if ((size_t)(end - ptr) < left)
+                left = (uint32_t)(end - ptr);
+
+            _filled += left;
+            ptr += left;
+            if (_filled == (uint32_t)_length + 1)
+                _state = WaitStart;
             break;
         }
         }
-        _pos++;
     }
 
-    if (_pos > 0 && _next_timeout < millis())
+    _chunk_pos = (uint16_t)(ptr - _chunk);
+    return status;
+}
+
+/**
+ * AP=2: decode the next piece of the chunk, up to the following
+ * start delimiter. Delimiters are never escaped so one showing up
+ * means a new frame, even if the last one isn't finished.
+ */
+Xbee3Response::Status XBee3::_unescape()
+{
+    uint8_t *piece = _chunk + _raw_pos;
+    uint16_t delimiter = (*piece == kStartByte) ? 1 : 0;
+
+    size_t consumed = 0;
+    if (delimiter)
+        _unescaper.reset();
+    size_t size = _unescaper.decode(piece + delimiter, _raw_size - _raw_pos - delimiter, consumed);
+
+    _chunk_pos = _raw_pos;
+    _chunk_size = (uint16_t)(_raw_pos + delimiter + size);
+    _raw_pos = (uint16_t)(_raw_pos + delimiter + consumed);
+
+    if (!delimiter)
     {
-        // We've timed out this request. Reset
-        _pos = 0;
-        return Xbee3Response::Timeout;
+        // Noise between frames. A decoded 0x7E isn't a delimiter
+        // so don't let the parser go looking for one in here.
+        if (_state == WaitStart)
+            _chunk_pos = _chunk_size;
+        return Xbee3Response::InProgress;
     }
 
-    if (_pos > 0)
+    if (_state == WaitStart)
         return Xbee3Response::InProgress;
-    else
-        return Xbee3Response::None;
+
+    // The frame we were in the middle of was cut short
+    bool reported = (_state == Skip);
+    _state = WaitStart;
+    return reported ? Xbee3Response::InProgress : Xbee3Response::Invalid;
+}
+
+/**
+ * Find a slot nobody else is holding on to, starting after the last
+ * one we used.
+ */
+bool XBee3::_claim_slot()
+{
+    for (uint8_t i = 1; i <= LUTIL_XBEE3_FRAME_SLOTS; i++)
+    {
+        uint8_t slot = (_slot + i) % LUTIL_XBEE3_FRAME_SLOTS;
+        if (_slots[slot].use_count() == 1)
+        {
+            _slot = slot;
+            return true;
+        }
+    }
+    return false;
+}
+
+// --------------------------------------------------------------------
+// Send queue
+
+uint8_t XBee3::queue(const XBee3Request &request)
+{
+    for (uint8_t i = 0; i < LUTIL_XBEE3_SEND_QUEUE; i++)
+    {
+        _Outgoing &item = _outgoing[i];
+        if (item.state != Free)
+            continue;
+
+        item.request = XBee3FrameCopy(request);
+        item.request.setFrameId(_next_frame_id());
+        item.state = Waiting;
+        item.attempts = 0;
+        item.status = XBee3Delivery::kNoStatus;
+        item.order = _order++;
+        item.deadline = millis();
+        item.first_sent = 0;
+
+        _service_queue();
+        return item.request.frameId();
+    }
+    return 0; // Full
+}
+
+void XBee3::setWindow(uint8_t window)
+{
+    _window = window ? window : 1;
+}
+
+void XBee3::setRetry(uint8_t retries, uint32_t timeout)
+{
+    _retries = retries;
+    _retry_timeout = timeout;
+}
+
+void XBee3::onDelivery(XBee3DeliveryCallback callback, void *data)
+{
+    _delivery = callback;
+    _delivery_data = data;
+}
+
+size_t XBee3::queued() const
+{
+    size_t count = 0;
+    for (uint8_t i = 0; i < LUTIL_XBEE3_SEND_QUEUE; i++)
+        count += (_outgoing[i].state == Waiting);
+    return count;
+}
+
+size_t XBee3::inFlight() const
+{
+    size_t count = 0;
+    for (uint8_t i = 0; i < LUTIL_XBEE3_SEND_QUEUE; i++)
+        count += (_outgoing[i].state == InFlight);
+    return count;
+}
+
+/**
+ * Time out frames the module never answered, then fill the window
+ * with the oldest waiting requests.
+ */
+void XBee3::_service_queue()
+{
+    uint32_t now = millis();
+    size_t flying = 0;
+
+    for (uint8_t i = 0; i < LUTIL_XBEE3_SEND_QUEUE; i++)
+    {
+        _Outgoing &item = _outgoing[i];
+        if (item.state == InFlight && reached(now, item.deadline))
+            _retry(item);
+        flying += (item.state == InFlight);
+    }
+
+    while (flying < _window && _output_stream)
+    {
+        _Outgoing *next = nullptr;
+        for (uint8_t i = 0; i < LUTIL_XBEE3_SEND_QUEUE; i++)
+        {
+            _Outgoing &item = _outgoing[i];
+            if (item.state != Waiting || !reached(now, item.deadline))
+                continue;
+            if (!next || (int32_t)(item.order - next->order) < 0)
+                next = &item;
+        }
+        if (!next)
+            break;
+
+        _transmit(*next);
+        flying++;
+    }
+}
+
+void XBee3::_transmit(_Outgoing &item)
+{
+    if (item.attempts == 0)
+        item.first_sent = micros();
+
+    item.attempts++;
+    item.state = InFlight;
+    item.deadline = millis() + _retry_timeout;
+    item.request.write_to(*_output_stream, _escaped);
+}
+
+void XBee3::_match_status(const XBee3TxStatus &status)
+{
+    for (uint8_t i = 0; i < LUTIL_XBEE3_SEND_QUEUE; i++)
+    {
+        _Outgoing &item = _outgoing[i];
+        if (item.state != InFlight || item.request.frameId() != status.frame_id)
+            continue;
+
+        item.status = status.delivery;
+        if (status.delivered())
+            _finish(item, true);
+        else
+            _retry(item);
+        break;
+    }
+    // A window slot may have opened up
+    _service_queue();
+}
+
+void XBee3::_retry(_Outgoing &item)
+{
+    if (item.attempts > _retries)
+    {
+        _finish(item, false);
+        return;
+    }
+
+    // Back off: timeout, 2x timeout, 4x timeout, ...
+    uint8_t shift = item.attempts - 1;
+    if (shift > 8)
+        shift = 8;
+    item.state = Waiting;
+    item.deadline = millis() + (_retry_timeout << shift);
+}
+
+void XBee3::_finish(_Outgoing &item, bool delivered)
+{
+    XBee3Delivery report;
+    report.frame_id = item.request.frameId();
+    report.delivered = delivered;
+    report.status = item.status;
+    report.attempts = item.attempts;
+    report.latency_us = micros() - item.first_sent;
+
+    // Release the payload before anyone hears about it
+    item.state = Free;
+    item.request = XBee3FrameCopy();
+
+    if (_delivery)
+        _delivery(report, _delivery_data);
+}
+
+/**
+ * 1-255 (0 means "no status please"), skipping ids still in use
+ */
+uint8_t XBee3::_next_frame_id()
+{
+    while (true)
+    {
+        _frame_id = (_frame_id == 0xFF) ? 1 : _frame_id + 1;
+
+        bool used = false;
+        for (uint8_t i = 0; i < LUTIL_XBEE3_SEND_QUEUE; i++)
+            used |= (_outgoing[i].state != Free &&
+                     _outgoing[i].request.frameId() == _frame_id);
+        if (!used)
+            return _frame_id;
+    }
+}
+
+void XBee3::setEscaped(bool escaped)
+{
+    _escaped = escaped;
+    _unescaper.reset();
 }
 
 void XBee3::setTimeout(size_t timeout)
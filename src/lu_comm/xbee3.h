@@ -10,6 +10,30 @@
 #pragma once
 #include "lutil.h"
 #include "lu_memory/managed_ptr.h"
+#include "lu_comm/checksum.h"
+
+// Largest frame (API id through the last data byte) we'll parse.
+// Bigger frames are skipped and poll() reports TooLarge.
+#ifndef LUTIL_XBEE3_MAX_FRAME
+#define LUTIL_XBEE3_MAX_FRAME 256
+#endif
+
+// Preallocated frames. A slot is reused only once every response
+// pointing into it is gone, so this is how many received frames
+// the application can hold on to at once (plus one to parse into).
+#ifndef LUTIL_XBEE3_FRAME_SLOTS
+#define LUTIL_XBEE3_FRAME_SLOTS 4
+#endif
+
+// Bytes pulled from the Stream per readBytes() call
+#ifndef LUTIL_XBEE3_READ_CHUNK
+#define LUTIL_XBEE3_READ_CHUNK 64
+#endif
+
+// Requests the send queue can hold (queued plus in flight)
+#ifndef LUTIL_XBEE3_SEND_QUEUE
+#define LUTIL_XBEE3_SEND_QUEUE 8
+#endif
 
 namespace lutil
 {
@@ -35,25 +59,207 @@ struct XBee3Address
 };
 
 /**
- * A request packages up a payload and address for the actual
- * module to send. This can format the 
+ * API frame types we know how to build or read
+ */
+namespace XBee3Api
+{
+enum Id : uint8_t
+{
+    AtCommand = 0x08,
+    TransmitRequest = 0x10,
+    ExplicitRequest = 0x11,
+    AtResponse = 0x88,
+    TransmitStatus = 0x8B,
+    ReceivePacket = 0x90,
+    ExplicitRx = 0x91,
+};
+}
+
+/**
+ * Escaped API mode (AP=2). After the start delimiter, any 0x7E, 0x7D,
+ * 0x11 or 0x13 goes out as 0x7D followed by the byte xor 0x20. Both
+ * directions look bytes up in one table and move the runs between
+ * escapes in bulk.
  */
-class XBee3Request
+class XBee3Escape
 {
 public:
-    XBee3Request(const XBee3Address &address);
+    static const uint8_t kEscape = 0x7D;
+
+    // Non-zero for the bytes that need escaping
+    static const uint8_t kTable[256];
+
+    static bool needed(uint8_t value) { return kTable[value] != 0; }
+
+    // Write data to out, escaped. Returns the bytes written.
+    static size_t write(Print &out, const uint8_t *data, size_t size);
+};
+
+/**
+ * Streaming AP=2 decoder. Undoes the escapes in place, remembering
+ * an escape byte that ends one buffer so the next one picks it up.
+ */
+class XBee3Unescaper
+{
+public:
+    XBee3Unescaper() : _pending(false) {}
+
+    // Decode data in place, stopping at a raw start delimiter (the
+    // only unescaped 0x7E). Returns the decoded size, consumed is
+    // how much input that used. Raw XON/XOFF bytes are dropped.
+    size_t decode(uint8_t *data, size_t size, size_t &consumed);
+
+    // A new frame started, forget any half escape
+    void reset() { _pending = false; }
+
+    bool pending() const { return _pending; }
+
+private:
+    bool _pending;
+};
+
+/**
+ * Anything we can send to the module. Subclasses provide their
+ * frame header, the payload, framing and checksum live here.
+ */
+class XBee3Frame
+{
+public:
+    XBee3Frame();
+    virtual ~XBee3Frame() {}
 
     // Set the request payload. This is copied into the request
     // and cleaned up once the request has been destroyed.
     void setPayload(uint8_t *payload, uint16_t size);
-    void setPayload(const managed_data &payload);
 
-    // Data formated in a way that XBee 3 modules can consume
+    // Share the payload instead (a managed_data converts too). The
+    // bytes are referenced, not copied.
+    void setPayload(const data_view &payload);
+
+    // A non-zero id asks the module to answer with a status frame
+    // (0x8B for transmits, 0x88 for AT commands) carrying that id
+    void setFrameId(uint8_t id) { _frame_id = id; }
+    uint8_t frameId() const { return _frame_id; }
+
+    // Largest header of any frame type (start delimiter, length and
+    // the explicit addressing fields)
+    static const uint16_t kMaxHeaderSize = 23;
+
+    // Bytes in the complete frame (header, payload and checksum)
+    size_t frame_size() const;
+
+    // Write the complete frame into buffer. Returns the bytes written
+    // or 0 when capacity is too small. Nothing is allocated.
+    size_t serialize_into(uint8_t *buffer, size_t capacity) const;
+
+    // Write the frame to out in pieces (header, the payload straight
+    // from its own buffer, checksum) without assembling it first.
+    // escaped frames it for AP=2.
+    size_t write_to(Print &out, bool escaped = false) const;
+
+    // Data formated in a way that XBee 3 modules can consume. The
+    // caller owns RawData::data (delete [] it), prefer the above.
     RawData data() const;
 
+    // Check a complete unescaped frame (delimiter through checksum)
+    // in one pass: framing, length and checksum
+    static bool validate(const uint8_t *frame, size_t size);
+
+protected:
+    friend class XBee3FrameCopy;
+
+    // Frame data up to the payload (API id first). Returns its size.
+    virtual uint16_t _frame_header(uint8_t *output) const = 0;
+
+    data_view _payload;
+    uint8_t _frame_id;
+
 private:
+    // Full header into output (kMaxHeaderSize), returns its size.
+    uint16_t _header(uint8_t *output, uint8_t &sum) const;
+};
+
+/**
+ * A request packages up a payload and address for the actual
+ * module to send (0x10 Transmit Request).
+ */
+class XBee3Request : public XBee3Frame
+{
+public:
+    XBee3Request(const XBee3Address &address);
+
+    // No address yet
+    XBee3Request();
+
+    // Start delimiter through options (everything before the payload)
+    static const uint16_t kHeaderSize = 17;
+
+protected:
+    uint16_t _frame_header(uint8_t *output) const override;
+
     XBee3Address _address;
-    managed_data _payload;
+};
+
+/**
+ * 0x11 Explicit Addressing Command. A transmit request with the
+ * Zigbee application layer fields spelled out.
+ */
+class XBee3ExplicitRequest : public XBee3Request
+{
+public:
+    XBee3ExplicitRequest(
+        const XBee3Address &address,
+        uint8_t source_endpoint,
+        uint8_t destination_endpoint,
+        uint16_t cluster,
+        uint16_t profile);
+
+protected:
+    uint16_t _frame_header(uint8_t *output) const override;
+
+    uint8_t _source_endpoint;
+    uint8_t _destination_endpoint;
+    uint16_t _cluster;
+    uint16_t _profile;
+};
+
+/**
+ * 0x08 Local AT Command. The payload is the parameter (if any)
+ *
+ * .. code-block:: cpp
+ *
+ *     XBee3AtCommand ni("NI", 1); // Node identifier, answered with 0x88
+ */
+class XBee3AtCommand : public XBee3Frame
+{
+public:
+    XBee3AtCommand(const char *command, uint8_t frame_id = 1);
+
+protected:
+    uint16_t _frame_header(uint8_t *output) const override;
+
+    char _command[2];
+};
+
+/**
+ * Any frame, captured by value: the header the original wrote is
+ * kept (so its frame type and fields go with it) and the payload is
+ * shared. Only the frame id can still be changed. This is what
+ * XBee3::queue() holds on to, a plain copy would slice off whatever
+ * the subclass adds.
+ */
+class XBee3FrameCopy : public XBee3Frame
+{
+public:
+    XBee3FrameCopy();
+    explicit XBee3FrameCopy(const XBee3Frame &frame);
+
+protected:
+    uint16_t _frame_header(uint8_t *output) const override;
+
+private:
+    uint8_t _header[kMaxHeaderSize - 3]; // No delimiter or length
+    uint8_t _header_size;
 };
 
 /**
@@ -71,6 +277,7 @@ public:
         Invalid,
         TooLarge,
         Timeout,
+        Overrun, // Every frame slot is still held, frame dropped
     };
 
     Xbee3Response();
@@ -81,30 +288,65 @@ public:
     uint8_t checksum() const { return _checksum; }
     uint8_t apiId() const { return _api_id; }
     uint16_t size() const { return _size; }
-    const managed_data &payload() const { return _payload; }
+    const data_view &payload() const { return _payload; }
 
+    // Source of a 0x90/0x91 frame
     XBee3Address sender() const;
-    managed_data data() const;
+
+    // The RF data (or AT response data). Shares the payload buffer,
+    // nothing is copied.
+    data_view data() const;
 
 protected:
     // Internal API for building the response;
     friend class XBee3;
-    uint8_t &operator[] (uint16_t pos);
-    void allocate();
-    void add_checksum(uint8_t cs);
-    void set_api_id(uint8_t id);
-    void add_size(uint16_t s);
+
+    // frame is the whole frame data, API id first
+    void set_frame(const data_view &frame, uint8_t checksum);
 
 private:
     XBee3Address _origin;
-    managed_data _payload;
+    data_view _payload;
     uint8_t _api_id;
     uint8_t _checksum;
     uint16_t _size;
 };
 
+struct XBee3TxStatus;
+
+/**
+ * Outcome of a queued request (see XBee3::queue())
+ */
+struct XBee3Delivery
+{
+    // status when the module never answered
+    static const uint8_t kNoStatus = 0xFF;
+
+    uint8_t frame_id;
+    bool delivered;
+    uint8_t status;      // Last 0x8B delivery status (0 is success)
+    uint8_t attempts;    // Transmissions it took
+    uint32_t latency_us; // First transmission to the final answer
+};
+
+typedef void (*XBee3DeliveryCallback)(const XBee3Delivery &report, void *data);
+
 /**
  * Wrapper class for an XBee Series 3.
+ *
+ * Requests passed to send() go out right away with no feedback.
+ * Requests passed to queue() get a frame id and are tracked
+ * until the module's 0x8B transmit status comes back:
+ *
+ * .. code-block:: cpp
+ *
+ *     void delivered(const lutil::XBee3Delivery &report, void *) { ... }
+ *
+ *     xbee.setWindow(4);        // frames in the air at once
+ *     xbee.setRetry(3, 500);    // 3 retries, 500ms status timeout
+ *     xbee.onDelivery(delivered);
+ *
+ *     xbee.queue(request);      // sent (and retried) from poll()
  */
 class XBee3
 {
@@ -114,12 +356,39 @@ public:
     Stream *stream() const;
     void setStream(Stream *input, Stream *output = nullptr);
 
-    // Send a payload request to another XBee3
-    void send(const XBee3Request &request);
+    // Send a payload request to another XBee3 (or any other frame)
+    void send(const XBee3Frame &request);
+
+    // Send with delivery tracking. Returns the frame id assigned to
+    // the request or 0 when the queue is full. Any request type goes
+    // (0x10, 0x11, fragments), it's held as an XBee3FrameCopy.
+    uint8_t queue(const XBee3Request &request);
+
+    // Most frames awaiting a transmit status at once
+    void setWindow(uint8_t window);
+
+    // Retries after a failed delivery or a missing status (timeout
+    // ms). Each retry waits twice as long as the one before.
+    void setRetry(uint8_t retries, uint32_t timeout);
+
+    void onDelivery(XBee3DeliveryCallback callback, void *data = nullptr);
+
+    size_t queued() const;   // Waiting on the window
+    size_t inFlight() const; // Waiting on a status
 
     // Check for an incoming transmission
     Xbee3Response::Status poll();
 
+    // Send, retry and time out queued requests without reading
+    // anything, for when incoming frames have to wait. poll() does
+    // this as well.
+    void service() { _service_queue(); }
+
+    // Same as above, and any valid frame is decoded and handed to
+    // handler (see XBee3Handler)
+    template<class H>
+    Xbee3Response::Status poll(H &handler);
+
     // Get the latest tranmission (if any)
     const Xbee3Response &response() const;
 
@@ -128,22 +397,242 @@ public:
     // reset
     void setTimeout(size_t timeout);
 
+    // Match the module's AP setting: true for escaped API mode
+    // (AP=2), false for plain API mode (AP=1, the default)
+    void setEscaped(bool escaped);
+    bool escaped() const { return _escaped; }
+
+    // Most bytes a single poll() pulls from the stream (0, the
+    // default, reads for as long as there's data). Keeps a busy
+    // link from holding up the loop.
+    void setReadBudget(uint16_t bytes) { _read_budget = bytes; }
+
 private:
+    enum _ParseState : uint8_t
+    {
+        WaitStart,
+        LengthHigh,
+        LengthLow,
+        FrameData,
+        Checksum,
+        Skip, // Dropping a frame we can't take
+    };
+
+    bool _claim_slot();
+    Xbee3Response::Status _parse();
+    Xbee3Response::Status _unescape();
+
+    enum _SendState : uint8_t
+    {
+        Free,
+        Waiting,  // Queued (or backing off before a retry)
+        InFlight, // Sent, waiting for the 0x8B
+    };
+
+    struct _Outgoing
+    {
+        XBee3FrameCopy request;
+        _SendState state;
+        uint8_t attempts;
+        uint8_t status;
+        uint32_t order;      // FIFO between waiting requests
+        uint32_t deadline;   // ms: retry backoff or status timeout
+        uint32_t first_sent; // us
+    };
+
+    void _service_queue();
+    void _transmit(_Outgoing &item);
+    void _match_status(const XBee3TxStatus &status);
+    void _retry(_Outgoing &item);
+    void _finish(_Outgoing &item, bool delivered);
+    uint8_t _next_frame_id();
+
     Stream *_stream = nullptr;
     Stream *_output_stream = nullptr;
 
     // When we poll, if the response is valid, this
-    // is populated
+    // is populated. It points straight into a frame slot.
     Xbee3Response _latest_response;
 
-    // While we're building a response we populate
-    // this (pushing it to the _latest_response once
-    // all data is collected)
-    Xbee3Response _working_response;
-    uint32_t _pos;
+    // Frames are parsed in place, into one of these
+    managed_data _slots[LUTIL_XBEE3_FRAME_SLOTS];
+    uint8_t _slot;
+
+    // Bytes read from the stream but not parsed yet. In AP=2 the
+    // chunk is decoded in place a piece at a time: _chunk_pos to
+    // _chunk_size is decoded, _raw_pos to _raw_size is still escaped.
+    uint8_t _chunk[LUTIL_XBEE3_READ_CHUNK];
+    uint16_t _chunk_pos;
+    uint16_t _chunk_size;
+    uint16_t _raw_pos;
+    uint16_t _raw_size;
+
+    bool _escaped;
+    uint16_t _read_budget;
+    XBee3Unescaper _unescaper;
+
+    _ParseState _state;
+    uint16_t _length;  // Frame data size (from the header)
+    uint32_t _filled;  // Frame data parsed so far
 
     uint32_t _next_timeout;
     uint32_t _timeout;
+
+    // Send queue
+    _Outgoing _outgoing[LUTIL_XBEE3_SEND_QUEUE];
+    uint32_t _order;
+    uint8_t _frame_id;
+    uint8_t _window;
+    uint8_t _retries;
+    uint32_t _retry_timeout;
+    XBee3DeliveryCallback _delivery;
+    void *_delivery_data;
 };
 
+// --------------------------------------------------------------------
+// Received frames. parse() decodes a response of the matching API id,
+// every data_view points into the response's frame slot.
+
+/** 0x90 Receive Packet */
+struct XBee3RxPacket
+{
+    static const uint8_t kApiId = XBee3Api::ReceivePacket;
+    static bool parse(const Xbee3Response &response, XBee3RxPacket &out);
+
+    XBee3Address sender;
+    uint16_t network; // 16 bit address
+    uint8_t options;
+    data_view data;
+};
+
+/** 0x91 Explicit Rx Indicator */
+struct XBee3ExplicitRx
+{
+    static const uint8_t kApiId = XBee3Api::ExplicitRx;
+    static bool parse(const Xbee3Response &response, XBee3ExplicitRx &out);
+
+    XBee3Address sender;
+    uint16_t network;
+    uint8_t source_endpoint;
+    uint8_t destination_endpoint;
+    uint16_t cluster;
+    uint16_t profile;
+    uint8_t options;
+    data_view data;
+};
+
+/** 0x8B Transmit Status, answers a request sent with a frame id */
+struct XBee3TxStatus
+{
+    static const uint8_t kApiId = XBee3Api::TransmitStatus;
+    static bool parse(const Xbee3Response &response, XBee3TxStatus &out);
+
+    bool delivered() const { return delivery == 0; }
+
+    uint8_t frame_id;
+    uint16_t network;
+    uint8_t retries;
+    uint8_t delivery;  // 0 is success
+    uint8_t discovery;
+};
+
+/** 0x88 AT Command Response */
+struct XBee3AtResponse
+{
+    static const uint8_t kApiId = XBee3Api::AtResponse;
+    static bool parse(const Xbee3Response &response, XBee3AtResponse &out);
+
+    bool ok() const { return status == 0; }
+
+    uint8_t frame_id;
+    char command[2];
+    uint8_t status;
+    data_view data;
+};
+
+/**
+ * Default (do nothing) handlers. Derive and redefine the ones you
+ * care about, they're resolved at compile time so no virtuals.
+ *
+ * .. code-block:: cpp
+ *
+ *     struct Radio : public lutil::XBee3Handler {
+ *         void on_receive(const lutil::XBee3RxPacket &packet) { ... }
+ *         void on_tx_status(const lutil::XBee3TxStatus &status) { ... }
+ *     };
+ *
+ *     Radio radio;
+ *     xbee.poll(radio);
+ */
+struct XBee3Handler
+{
+    void on_receive(const XBee3RxPacket &) {}
+    void on_explicit(const XBee3ExplicitRx &) {}
+    void on_tx_status(const XBee3TxStatus &) {}
+    void on_at_response(const XBee3AtResponse &) {}
+    void on_unknown(const Xbee3Response &) {}
+};
+
+template<class H>
+inline void _xbee3_deliver(H &handler, const XBee3RxPacket &frame) { handler.on_receive(frame); }
+
+template<class H>
+inline void _xbee3_deliver(H &handler, const XBee3ExplicitRx &frame) { handler.on_explicit(frame); }
+
+template<class H>
+inline void _xbee3_deliver(H &handler, const XBee3TxStatus &frame) { handler.on_tx_status(frame); }
+
+template<class H>
+inline void _xbee3_deliver(H &handler, const XBee3AtResponse &frame) { handler.on_at_response(frame); }
+
+template<class H, class F>
+bool _xbee3_route(H &handler, const Xbee3Response &response)
+{
+    F frame;
+    if (!F::parse(response, frame))
+        return false; // Too short for its type
+    _xbee3_deliver(handler, frame);
+    return true;
+}
+
+/**
+ * Decode response and hand it to the matching handler. The routes
+ * are a static table built per handler type at compile time.
+ * Returns false for malformed or unknown frames.
+ */
+template<class H>
+bool xbee3_dispatch(H &handler, const Xbee3Response &response)
+{
+    struct Route
+    {
+        uint8_t api_id;
+        bool (*route)(H &, const Xbee3Response &);
+    };
+
+    static const Route s_routes[] = {
+        { XBee3RxPacket::kApiId, &_xbee3_route<H, XBee3RxPacket> },
+        { XBee3TxStatus::kApiId, &_xbee3_route<H, XBee3TxStatus> },
+        { XBee3AtResponse::kApiId, &_xbee3_route<H, XBee3AtResponse> },
+        { XBee3ExplicitRx::kApiId, &_xbee3_route<H, XBee3ExplicitRx> },
+    };
+
+    for (const Route &route : s_routes)
+    {
+        if (route.api_id == response.apiId())
+            return route.route(handler, response);
+    }
+
+    handler.on_unknown(response);
+    return false;
+}
+
+template<class H>
+Xbee3Response::Status XBee3::poll(H &handler)
+{
+    Xbee3Response::Status status = poll();
+    if (status == Xbee3Response::Valid)
+        xbee3_dispatch(handler, _latest_response);
+    return status;
+}
+
 } // namespace lutil
\ No newline at end of file
@@ -0,0 +1,199 @@
+#include "xbee3_fragment.h"
+
+namespace lutil
+{
+
+void XBee3FragmentHeader::write(uint8_t *output) const
+{
+    output[0] = kMarker;
+    output[1] = message;
+    output[2] = index;
+    output[3] = count;
+    output[4] = (size >> 8) & 0xFF;
+    output[5] = size & 0xFF;
+}
+
+bool XBee3FragmentHeader::parse(const data_view &payload, XBee3FragmentHeader &out)
+{
+    if (payload.size() < kSize || payload[0] != kMarker)
+        return false;
+
+    out.message = payload[1];
+    out.index = payload[2];
+    out.count = payload[3];
+    out.size = (uint16_t)((payload[4] << 8) | payload[5]);
+    return out.count > 0 && out.index < out.count && out.size > 0;
+}
+
+// --------------------------------------------------------------------
+
+XBee3FragmentRequest::XBee3FragmentRequest(
+    const XBee3Address &address,
+    const XBee3FragmentHeader &header)
+    : XBee3Request(address)
+    , _fragment(header)
+{}
+
+uint16_t XBee3FragmentRequest::_frame_header(uint8_t *output) const
+{
+    uint16_t size = XBee3Request::_frame_header(output);
+    _fragment.write(output + size);
+    return size + XBee3FragmentHeader::kSize;
+}
+
+// --------------------------------------------------------------------
+
+XBee3Fragmenter::XBee3Fragmenter(uint8_t mtu)
+    : _mtu(mtu > XBee3FragmentHeader::kSize ? mtu : XBee3FragmentHeader::kSize + 1)
+    , _message(0)
+{}
+
+uint16_t XBee3Fragmenter::fragments(size_t size) const
+{
+    size_t chunk = _mtu - XBee3FragmentHeader::kSize;
+    size_t count = (size + chunk - 1) / chunk;
+    if (size == 0 || size > 0xFFFF || count > 0xFF)
+        return 0;
+    return (uint16_t)count;
+}
+
+uint8_t XBee3Fragmenter::send(XBee3 &xbee, const XBee3Address &to, const data_view &message)
+{
+    uint16_t count = fragments(message.size());
+    if (!count)
+        return 0;
+
+    XBee3FragmentHeader header;
+    header.message = _message++;
+    header.count = (uint8_t)count;
+    header.size = (uint16_t)message.size();
+
+    size_t chunk = _mtu - XBee3FragmentHeader::kSize;
+    for (uint16_t i = 0; i < count; i++)
+    {
+        header.index = (uint8_t)i;
+        XBee3FragmentRequest request(to, header);
+        request.setPayload(message.slice(i * chunk, chunk));
+        xbee.send(request);
+    }
+    return (uint8_t)count;
+}
+
+// --------------------------------------------------------------------
+
+XBee3Reassembler::XBee3Reassembler(size_t capacity)
+    : _buffer(capacity)
+    , _size(0)
+    , _active(false)
+    , _done(false)
+    , _from({0, 0})
+    , _header()
+    , _chunk(0)
+    , _received(0)
+    , _last_time(0)
+    , _timeout(2000)
+    , _abandoned(0)
+{
+    memset(_seen, 0, sizeof(_seen));
+}
+
+bool XBee3Reassembler::_has(uint8_t index) const
+{
+    return (_seen[index >> 5] >> (index & 31)) & 1;
+}
+
+void XBee3Reassembler::_start(const XBee3Address &from, const XBee3FragmentHeader &header)
+{
+    if (_active)
+        _abandoned++;
+
+    _active = true;
+    _done = false;
+    _from = from;
+    _header = header;
+    _chunk = 0;
+    _received = 0;
+    memset(_seen, 0, sizeof(_seen));
+}
+
+XBee3Reassembler::Status XBee3Reassembler::add(const XBee3Address &from, const data_view &payload)
+{
+    XBee3FragmentHeader header;
+    if (!XBee3FragmentHeader::parse(payload, header))
+        return Ignored;
+
+    uint32_t now = millis();
+    bool same = (_active || _done) &&
+                from.high == _from.high && from.low == _from.low &&
+                header.message == _header.message &&
+                header.count == _header.count &&
+                header.size == _header.size &&
+                (uint32_t)(now - _last_time) < _timeout;
+
+    if (same && _done)
+        return Duplicate; // Straggler from the last message
+
+    if (!same)
+    {
+        if (header.size > _buffer.size())
+            return Overrun;
+
+        // The last message still lives in the buffer
+        if (_buffer.use_count() > 1)
+            return Overrun;
+
+        _size = 0;
+        _start(from, header);
+    }
+    _last_time = now;
+
+    if (_has(header.index))
+        return Duplicate;
+
+    // Every fragment but the last holds chunk bytes, so any one of
+    // them tells us how big that is
+    uint16_t length = (uint16_t)(payload.size() - XBee3FragmentHeader::kSize);
+    bool last = (header.index == header.count - 1);
+    uint16_t chunk;
+    if (!last)
+        chunk = length;
+    else if (header.count == 1)
+        chunk = header.size;
+    else
+    {
+        uint16_t rest = header.size - length;
+        if (length > header.size || rest % (header.count - 1))
+            return Invalid;
+        chunk = rest / (header.count - 1);
+    }
+
+    if (chunk == 0 ||
+        (uint32_t)chunk * (header.count - 1) >= header.size ||
+        (_chunk && chunk != _chunk))
+        return Invalid;
+
+    uint32_t offset = (uint32_t)header.index * chunk;
+    if (offset + length > header.size || (last && offset + length != header.size))
+        return Invalid;
+
+    _chunk = chunk;
+    memcpy(_buffer.get() + offset, payload.get() + XBee3FragmentHeader::kSize, length);
+    _seen[header.index >> 5] |= (uint32_t)1 << (header.index & 31);
+
+    if (++_received < header.count)
+        return Partial;
+
+    _active = false;
+    _done = true;
+    _size = header.size;
+    return Complete;
+}
+
+data_view XBee3Reassembler::message() const
+{
+    if (!_size)
+        return data_view();
+    return _buffer.slice(0, _size);
+}
+
+}
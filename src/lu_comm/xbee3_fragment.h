@@ -0,0 +1,164 @@
+/**
+ * Messages bigger than one RF payload, on top of XBee3.
+ *
+ * The sender splits a message into MTU sized fragments, each a 0x10
+ * transmit request whose payload starts with a small header:
+ *
+ * |   byte   |   value    |                 Detail                  |
+ * +----------+------------+-----------------------------------------+
+ * |     0    |     F5     | Fragment marker                         |
+ * |     1    |     XX     | Message id (per sender, wraps)          |
+ * |     2    |     XX     | Fragment index                          |
+ * |     3    |     XX     | Fragment count                          |
+ * |    4-5   |   XX  XX   | Message size                            |
+ * +----------+------------+-----------------------------------------+
+ *
+ * Every fragment but the last carries the same number of bytes, so
+ * the receiver can place fragments as they come, in any order, into
+ * one preallocated buffer.
+ *
+ * .. code-block:: cpp
+ *
+ *     // Sender
+ *     lutil::XBee3Fragmenter fragmenter;
+ *     fragmenter.send(xbee, addr, config_blob);
+ *
+ *     // Receiver
+ *     lutil::XBee3Reassembler messages;
+ *     if (messages.add(packet.sender, packet.data) == lutil::XBee3Reassembler::Complete)
+ *         handle(messages.message());
+ */
+#pragma once
+#include "lu_comm/xbee3.h"
+
+// Largest RF payload, fragment header included (NP on the module,
+// 84 bytes for an unencrypted Zigbee unicast)
+#ifndef LUTIL_XBEE3_MTU
+#define LUTIL_XBEE3_MTU 84
+#endif
+
+// Largest message the reassembler takes by default
+#ifndef LUTIL_XBEE3_MESSAGE_MAX
+#define LUTIL_XBEE3_MESSAGE_MAX 1024
+#endif
+
+namespace lutil
+{
+
+/**
+ * The header at the front of every fragment
+ */
+struct XBee3FragmentHeader
+{
+    static const uint8_t kMarker = 0xF5;
+    static const uint8_t kSize = 6;
+
+    uint8_t message;
+    uint8_t index;
+    uint8_t count;
+    uint16_t size;
+
+    void write(uint8_t *output) const;
+
+    // False when payload doesn't start with a sane header
+    static bool parse(const data_view &payload, XBee3FragmentHeader &out);
+};
+
+/**
+ * A transmit request carrying one fragment. The fragment header goes
+ * out with the frame header so the payload stays a view into the
+ * message - nothing is copied.
+ */
+class XBee3FragmentRequest : public XBee3Request
+{
+public:
+    XBee3FragmentRequest(const XBee3Address &address, const XBee3FragmentHeader &header);
+
+protected:
+    uint16_t _frame_header(uint8_t *output) const override;
+
+    XBee3FragmentHeader _fragment;
+};
+
+/**
+ * Splits messages into fragments and sends them
+ */
+class XBee3Fragmenter
+{
+public:
+    XBee3Fragmenter(uint8_t mtu = LUTIL_XBEE3_MTU);
+
+    // Send message in as many frames as it takes. Returns how many,
+    // 0 when it can't be split (empty, too big for 255 fragments
+    // or 64KB).
+    uint8_t send(XBee3 &xbee, const XBee3Address &to, const data_view &message);
+
+    // Fragments it takes to send size bytes (0 when it can't)
+    uint16_t fragments(size_t size) const;
+
+    uint8_t mtu() const { return _mtu; }
+
+private:
+    uint8_t _mtu;
+    uint8_t _message;
+};
+
+/**
+ * Puts fragmented messages back together, one at a time, in a buffer
+ * allocated up front. Fragments can arrive in any order and
+ * duplicates (even of a message just completed) are ignored.
+ *
+ * A fragment of a different message (another sender or message id)
+ * abandons the one in progress, as does a gap longer than the
+ * timeout.
+ */
+class XBee3Reassembler
+{
+public:
+    enum Status : uint8_t
+    {
+        Ignored,   // Not a fragment
+        Partial,   // Taken, message not done yet
+        Duplicate, // Already had that fragment
+        Complete,  // message() is ready
+        Invalid,   // Fragment doesn't fit the message it claims to be
+        Overrun,   // Message too big, or the last one's still held
+    };
+
+    XBee3Reassembler(size_t capacity = LUTIL_XBEE3_MESSAGE_MAX);
+
+    // Take a received payload (e.g. XBee3RxPacket::data)
+    Status add(const XBee3Address &from, const data_view &payload);
+
+    // The last completed message. It shares the buffer, so the next
+    // message is dropped (Overrun) while anyone still holds this.
+    data_view message() const;
+
+    // ms between fragments before a message is given up on
+    void setTimeout(uint32_t timeout) { _timeout = timeout; }
+
+    size_t capacity() const { return _buffer.size(); }
+
+    // Messages abandoned part way
+    uint32_t abandoned() const { return _abandoned; }
+
+private:
+    bool _has(uint8_t index) const;
+    void _start(const XBee3Address &from, const XBee3FragmentHeader &header);
+
+    managed_data _buffer;
+    uint16_t _size;       // Complete message size (0 for none)
+
+    bool _active;         // A message is in progress
+    bool _done;           // ...or just completed (for duplicates)
+    XBee3Address _from;
+    XBee3FragmentHeader _header;
+    uint16_t _chunk;      // Bytes per fragment (bar the last)
+    uint16_t _received;   // Fragments so far
+    uint32_t _seen[8];    // Bitmap of fragment indices
+    uint32_t _last_time;
+    uint32_t _timeout;
+    uint32_t _abandoned;
+};
+
+}
@@ -0,0 +1,126 @@
+#include "xbee3_hub.h"
+
+namespace lutil
+{
+
+XBee3Hub::XBee3Hub()
+    : Processable()
+    , _first(0)
+    , _slice_frames(4)
+    , _slice_bytes(LUTIL_XBEE3_READ_CHUNK)
+    , _head(0)
+    , _count(0)
+{}
+
+int XBee3Hub::add(XBee3 *radio)
+{
+    if (!radio || !_radios.push({ radio, 0, XBee3HubStats() }))
+        return -1;
+
+    radio->setReadBudget(_slice_bytes);
+    return (int)_radios.count() - 1;
+}
+
+void XBee3Hub::setSlice(uint8_t frames, uint16_t bytes)
+{
+    _slice_frames = frames ? frames : 1;
+    _slice_bytes = bytes;
+    for (size_t i = 0; i < _radios.count(); i++)
+        _radios[i].radio->setReadBudget(bytes);
+}
+
+void XBee3Hub::process()
+{
+    uint8_t count = (uint8_t)_radios.count();
+    if (!count)
+        return;
+
+    uint16_t queued = 0;
+    for (uint8_t i = 0; i < count; i++)
+        queued += _service((uint8_t)((_first + i) % count));
+
+    // Rotate who goes first so nobody always gets the leftovers
+    _first = (uint8_t)((_first + 1) % count);
+
+    if (queued)
+        post(FrameQueued, queued); // Delivered once every due task ran
+}
+
+uint8_t XBee3Hub::_service(uint8_t index)
+{
+    // One slot is always left for the radio to parse into
+    static const uint8_t kMaxHeld = LUTIL_XBEE3_FRAME_SLOTS - 1;
+
+    _Radio &entry = _radios[index];
+    if (_count == LUTIL_XBEE3_HUB_QUEUE || entry.held >= kMaxHeld)
+    {
+        // Leave the bytes in the stream until there's room, but
+        // keep its sends, retries and timeouts going
+        entry.radio->service();
+        entry.stats.deferred++;
+        return 0;
+    }
+
+    uint32_t start = micros();
+    uint8_t queued = 0;
+    bool more = true;
+
+    for (uint8_t i = 0; more && i < _slice_frames; i++)
+    {
+        switch (entry.radio->poll())
+        {
+        case Xbee3Response::Valid:
+        {
+            XBee3HubFrame &frame = _queue[(_head + _count) % LUTIL_XBEE3_HUB_QUEUE];
+            frame.radio = index;
+            frame.response = entry.radio->response();
+            _count++;
+            queued++;
+            entry.held++;
+            more = _count < LUTIL_XBEE3_HUB_QUEUE && entry.held < kMaxHeld;
+
+            entry.stats.frames++;
+            entry.stats.bytes += frame.response.size();
+            break;
+        }
+        case Xbee3Response::Invalid:
+        case Xbee3Response::TooLarge:
+            entry.stats.errors++;
+            break;
+        case Xbee3Response::Timeout:
+            entry.stats.timeouts++;
+            break;
+        case Xbee3Response::Overrun:
+            entry.stats.overruns++;
+            break;
+        case Xbee3Response::None:
+        case Xbee3Response::InProgress:
+            more = false; // Nothing more to take this turn
+            break;
+        }
+    }
+
+    entry.stats.busy_us += micros() - start;
+    return queued;
+}
+
+bool XBee3Hub::pop(XBee3HubFrame &frame)
+{
+    if (!_count)
+        return false;
+
+    frame = _queue[_head];
+    _radios[frame.radio].held--;
+    _queue[_head] = XBee3HubFrame(); // Let go of the radio's slot
+    _head = (uint8_t)((_head + 1) % LUTIL_XBEE3_HUB_QUEUE);
+    _count--;
+    return true;
+}
+
+void XBee3Hub::resetStats()
+{
+    for (size_t i = 0; i < _radios.count(); i++)
+        _radios[i].stats = XBee3HubStats();
+}
+
+}
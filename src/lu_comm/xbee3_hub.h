@@ -0,0 +1,117 @@
+/**
+ * Several XBee3 radios serviced from one Processable.
+ *
+ * Every process() gives each radio a bounded turn (a few frames, a
+ * capped number of bytes) starting with a different radio each time,
+ * so one busy link can't starve the rest. Frames from all radios
+ * land in a single queue, oldest first.
+ *
+ * .. code-block:: cpp
+ *
+ *     lutil::XBee3 north, south;
+ *     lutil::XBee3Hub hub; // Registers with the Processor
+ *
+ *     hub.add(&north);
+ *     hub.add(&south);
+ *     hub.setSlice(4, 128); // 4 polls of up to 128 bytes a turn
+ *
+ *     void loop() {
+ *         lutil::Processor::get().process();
+ *
+ *         lutil::XBee3HubFrame frame;
+ *         while (hub.pop(frame))
+ *             route(frame.radio, frame.response);
+ *     }
+ */
+#pragma once
+#include "lu_comm/xbee3.h"
+#include "lu_process/process.h"
+
+// Radios one hub can hold
+#ifndef LUTIL_XBEE3_HUB_RADIOS
+#define LUTIL_XBEE3_HUB_RADIOS 4
+#endif
+
+// Frames waiting in the merged queue. Each one holds a frame slot of
+// its radio so a radio stops getting turns (rather than dropping
+// frames) while LUTIL_XBEE3_FRAME_SLOTS - 1 of its frames wait.
+#ifndef LUTIL_XBEE3_HUB_QUEUE
+#define LUTIL_XBEE3_HUB_QUEUE 8
+#endif
+
+namespace lutil
+{
+
+struct XBee3HubFrame
+{
+    uint8_t radio; // Index from XBee3Hub::add()
+    Xbee3Response response;
+};
+
+struct XBee3HubStats
+{
+    uint32_t frames;   // Valid frames queued
+    uint32_t bytes;    // Frame data in those
+    uint32_t errors;   // Invalid or TooLarge
+    uint32_t timeouts;
+    uint32_t overruns; // Frames the radio had no slot for
+    uint32_t deferred; // Turns skipped, no room to queue
+    uint32_t busy_us;  // Time spent polling
+};
+
+class XBee3Hub : public Processable
+{
+public:
+    enum Trigger
+    {
+        FrameQueued = 1, // Posted, the payload is how many frames
+    };
+
+    XBee3Hub();
+
+    // Index of the radio (for XBee3HubFrame::radio), -1 when full
+    int add(XBee3 *radio);
+
+    size_t radios() const { return _radios.count(); }
+    XBee3 *radio(uint8_t index) const { return _radios[index].radio; }
+
+    // A radio's turn: up to frames polls, each reading at most
+    // bytes from its stream (0 for no byte limit)
+    void setSlice(uint8_t frames, uint16_t bytes);
+
+    void init() override {}
+
+    // One turn for every radio
+    void process() override;
+
+    // Oldest queued frame, false when there's none
+    bool pop(XBee3HubFrame &frame);
+
+    size_t pending() const { return _count; }
+
+    const XBee3HubStats &stats(uint8_t index) const { return _radios[index].stats; }
+    void resetStats();
+
+private:
+    struct _Radio
+    {
+        XBee3 *radio;
+        uint8_t held; // Of its frames, how many are queued
+        XBee3HubStats stats;
+    };
+
+    // Returns frames queued
+    uint8_t _service(uint8_t index);
+
+    StaticVec<_Radio, LUTIL_XBEE3_HUB_RADIOS> _radios;
+    uint8_t _first;       // Who goes first next turn
+
+    uint8_t _slice_frames;
+    uint16_t _slice_bytes;
+
+    XBee3HubFrame _queue[LUTIL_XBEE3_HUB_QUEUE];
+    uint8_t _head;
+    uint8_t _count;
+};
+
+}
@@ -2,7 +2,8 @@
     ini format reader
 */
 #include "lutil.h"
-#include "lu_storage/map.h"
+#include "lu_storage/hash_map.h"
+#include "lu_storage/interner.h"
 #include "lu_memory/managed_ptr.h"
 
 namespace lutil {
@@ -30,7 +31,9 @@ public:
 private:
     void parse();
 
-    Map<lutil::managed_string, lutil::managed_string> _data;
+    // Keys are interned ("section.name") so lookups hash once and
+    // compare atoms from then on
+    HashMap<Atom, lutil::managed_string> _data;
 };
 
 }
\ No newline at end of file
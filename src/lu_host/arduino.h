@@ -0,0 +1,129 @@
+/*
+    Host (BUILD_LIB) stand-ins for the few pieces of the Arduino core
+    the library leans on: Print/Stream and the clock. Just enough to
+    build and benchmark the uC code paths on a desktop.
+
+    Define LUTIL_NO_HOST_SHIM if you bring your own.
+*/
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <stdint.h>
+
+class Print {
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t value) = 0;
+
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        size_t written = 0;
+        while (size--) {
+            if (!write(*buffer++))
+                break;
+            written++;
+        }
+        return written;
+    }
+
+    size_t write(const char *buffer, size_t size) {
+        return write((const uint8_t *)buffer, size);
+    }
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    virtual size_t readBytes(uint8_t *buffer, size_t length) {
+        size_t count = 0;
+        while (count < length) {
+            int value = read();
+            if (value < 0)
+                break;
+            *buffer++ = (uint8_t)value;
+            count++;
+        }
+        return count;
+    }
+
+    size_t readBytes(char *buffer, size_t length) {
+        return readBytes((uint8_t *)buffer, length);
+    }
+};
+
+namespace lutil {
+namespace host {
+
+inline std::chrono::steady_clock::time_point start_time() {
+    static const std::chrono::steady_clock::time_point s_start =
+        std::chrono::steady_clock::now();
+    return s_start;
+}
+
+// The ManualClock in charge, if any
+inline const uint64_t *&manual_time() {
+    static const uint64_t *s_time = nullptr;
+    return s_time;
+}
+
+/*
+    Takes over millis()/micros() for as long as it lives so tests and
+    benchmarks can step time instead of sleeping.
+
+    .. code-block:: cpp
+
+        lutil::host::ManualClock clock;
+        clock.advance_ms(1500); // millis() == 1500
+*/
+class ManualClock {
+public:
+    explicit ManualClock(uint64_t start_us = 0)
+        : _now(start_us)
+        , _previous(manual_time())
+    {
+        manual_time() = &_now;
+    }
+
+    ~ManualClock() {
+        manual_time() = _previous;
+    }
+
+    ManualClock(const ManualClock &) = delete;
+    ManualClock &operator=(const ManualClock &) = delete;
+
+    void advance_us(uint64_t us) { _now += us; }
+    void advance_ms(uint64_t ms) { _now += ms * 1000; }
+    void set_us(uint64_t us) { _now = us; }
+
+    uint64_t now_us() const { return _now; }
+
+private:
+    uint64_t _now;
+    const uint64_t *_previous;
+};
+
+// Microseconds since the first call (or the ManualClock's time)
+inline uint64_t now_us() {
+    if (manual_time())
+        return *manual_time();
+
+    using namespace std::chrono;
+    return (uint64_t)duration_cast<microseconds>(
+        steady_clock::now() - start_time()
+    ).count();
+}
+
+}
+}
+
+// Counted from the first call, like a board counts from reset
+inline unsigned long millis() {
+    return (unsigned long)(lutil::host::now_us() / 1000);
+}
+
+inline unsigned long micros() {
+    return (unsigned long)lutil::host::now_us();
+}
@@ -0,0 +1,276 @@
+/*
+    Host (BUILD_LIB) Stream that simulates a serial line, for driving
+    XBee3 and friends on a desktop.
+
+    Bytes written to a MockStream come back out of its peer (or of
+    itself when it has none - a loopback plug). On the way they can
+    be rate limited to a baud rate, have bits flipped or go missing,
+    and they're held in a fixed ring buffer that overflows like a
+    real UART FIFO when nobody reads.
+
+    .. code-block:: cpp
+
+        lutil::host::ManualClock clock;
+        lutil::host::LoopbackPair link;
+        link.a().setBaud(115200);
+
+        lutil::XBee3 radio_a, radio_b;
+        radio_a.setStream(&link.a());
+        radio_b.setStream(&link.b());
+
+        radio_a.send(request);
+        clock.advance_ms(5);  // time on the wire
+        radio_b.poll();       // Valid
+*/
+#pragma once
+#include "lutil.h"
+
+namespace lutil {
+namespace host {
+
+class MockStream : public Stream {
+public:
+    explicit MockStream(size_t capacity = 4096)
+        : _data(new uint8_t[capacity])
+        , _arrival(new uint64_t[capacity])
+        , _capacity(capacity)
+        , _head(0)
+        , _count(0)
+        , _ready(0)
+        , _byte_ns(0)
+        , _line_free_ns(0)
+        , _flip_one_in(0)
+        , _drop_one_in(0)
+        , _seed(1)
+        , _peer(nullptr)
+    {
+        reset_stats();
+    }
+
+    ~MockStream() {
+        delete [] _data;
+        delete [] _arrival;
+    }
+
+    MockStream(const MockStream &) = delete;
+    MockStream &operator=(const MockStream &) = delete;
+
+    // ----------------------------------------------------------------
+    // LINE
+
+    // Our writes arrive at peer. nullptr loops them back to us.
+    void connect(MockStream *peer) { _peer = peer; }
+
+    // Bytes per second arriving at *this* end. 0 is instant.
+    void setByteRate(uint32_t rate) {
+        _byte_ns = rate ? 1000000000ULL / rate : 0;
+    }
+
+    // 8N1 framing, ten bits a byte
+    void setBaud(uint32_t baud) { setByteRate(baud / 10); }
+
+    /*
+        Noise on bytes arriving here: each one has a 1 in flip_one_in
+        chance of a flipped bit and 1 in drop_one_in of going missing
+        (0 turns either off). seed makes runs repeatable.
+    */
+    void setNoise(uint32_t flip_one_in, uint32_t drop_one_in = 0, uint32_t seed = 1) {
+        _flip_one_in = flip_one_in;
+        _drop_one_in = drop_one_in;
+        _seed = seed ? seed : 1;
+    }
+
+    // Put bytes on the line towards this end, as if the other side
+    // had written them. Returns how many fit in the buffer.
+    size_t inject(const uint8_t *data, size_t size) {
+        uint64_t now_ns = now_us() * 1000;
+        if (_line_free_ns < now_ns)
+            _line_free_ns = now_ns;
+
+        size_t accepted = 0;
+        for (size_t i = 0; i < size; i++) {
+            _stats.injected++;
+            _line_free_ns += _byte_ns;
+
+            uint8_t value = data[i];
+            if (_drop_one_in && _random() % _drop_one_in == 0) {
+                _stats.dropped++;
+                continue;
+            }
+            if (_flip_one_in && _random() % _flip_one_in == 0) {
+                value ^= (uint8_t)(1u << (_random() % 8));
+                _stats.flipped++;
+            }
+            if (_count == _capacity) {
+                _stats.overflowed++;
+                continue;
+            }
+
+            size_t slot = (_head + _count) % _capacity;
+            _data[slot] = value;
+            _arrival[slot] = (_line_free_ns + 999) / 1000;
+            _count++;
+            accepted++;
+        }
+        return accepted;
+    }
+
+    // Flip bits (mask) in the byte index places into what's buffered
+    bool corrupt(size_t index, uint8_t mask = 0x01) {
+        if (index >= _count)
+            return false;
+        _data[(_head + index) % _capacity] ^= mask;
+        _stats.flipped++;
+        return true;
+    }
+
+    // Forget everything buffered, and anything still on the line
+    void clear() {
+        _head = 0;
+        _count = 0;
+        _ready = 0;
+        _line_free_ns = 0;
+    }
+
+    struct Stats {
+        uint64_t injected;   // Bytes put on the line
+        uint64_t delivered;  // Bytes read back out
+        uint64_t dropped;    // Lost to noise
+        uint64_t flipped;    // Damaged by noise
+        uint64_t overflowed; // Lost to a full buffer
+    };
+
+    const Stats &stats() const { return _stats; }
+
+    void reset_stats() {
+        _stats.injected = 0;
+        _stats.delivered = 0;
+        _stats.dropped = 0;
+        _stats.flipped = 0;
+        _stats.overflowed = 0;
+    }
+
+    // Buffered, including bytes still on their way
+    size_t buffered() const { return _count; }
+
+    // ----------------------------------------------------------------
+    // STREAM
+
+    int available() override {
+        _arrive();
+        return (int)_ready;
+    }
+
+    int read() override {
+        if (available() == 0)
+            return -1;
+        uint8_t value = _data[_head];
+        _pop(1);
+        return value;
+    }
+
+    int peek() override {
+        if (available() == 0)
+            return -1;
+        return _data[_head];
+    }
+
+    size_t readBytes(uint8_t *buffer, size_t length) override {
+        size_t size = (size_t)available();
+        if (length < size)
+            size = length;
+
+        // At most two runs (around the end of the ring)
+        size_t first = _capacity - _head;
+        if (first > size)
+            first = size;
+        memcpy(buffer, _data + _head, first);
+        memcpy(buffer + first, _data, size - first);
+
+        _pop(size);
+        return size;
+    }
+
+    using Print::write;
+
+    size_t write(uint8_t value) override {
+        return write(&value, 1);
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override {
+        (_peer ? _peer : this)->inject(buffer, size);
+        return size; // The sender can't tell what got lost
+    }
+
+private:
+    // Count the bytes that have arrived by now
+    void _arrive() {
+        uint64_t now = now_us();
+        while (_ready < _count && _arrival[(_head + _ready) % _capacity] <= now)
+            _ready++;
+    }
+
+    void _pop(size_t size) {
+        _head = (_head + size) % _capacity;
+        _count -= size;
+        _ready -= size;
+        _stats.delivered += size;
+    }
+
+    // xorshift32
+    uint32_t _random() {
+        _seed ^= _seed << 13;
+        _seed ^= _seed >> 17;
+        _seed ^= _seed << 5;
+        return _seed;
+    }
+
+    uint8_t *_data;
+    uint64_t *_arrival; // us each byte is readable
+    size_t _capacity;
+    size_t _head;
+    size_t _count;
+    size_t _ready;      // Of _count, how many have arrived
+
+    uint64_t _byte_ns;
+    uint64_t _line_free_ns;
+
+    uint32_t _flip_one_in;
+    uint32_t _drop_one_in;
+    uint32_t _seed;
+
+    MockStream *_peer;
+    Stats _stats;
+};
+
+
+/*
+    Two MockStreams wired back to back, a() writes arrive at b() and
+    the other way round. Each direction has its own rate and noise
+    (set on the receiving end).
+*/
+class LoopbackPair {
+public:
+    explicit LoopbackPair(size_t capacity = 4096)
+        : _a(capacity)
+        , _b(capacity)
+    {
+        _a.connect(&_b);
+        _b.connect(&_a);
+    }
+
+    MockStream &a() { return _a; }
+    MockStream &b() { return _b; }
+
+    void setBaud(uint32_t baud) {
+        _a.setBaud(baud);
+        _b.setBaud(baud);
+    }
+
+private:
+    MockStream _a;
+    MockStream _b;
+};
+
+}
+}
@@ -0,0 +1,218 @@
+#include "parallel_processor.h"
+
+namespace lutil {
+namespace host {
+
+ParallelProcessor::ParallelProcessor(unsigned threads, Processor &processor)
+    : _processor(processor)
+    , _now(0)
+    , _waiting_size(0)
+    , _remaining(0)
+    , _generation(0)
+    , _stopping(false)
+    , _steals(0)
+{
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+
+    for (unsigned i = 0; i < threads; i++)
+        _queues.emplace_back(new Queue());
+
+    // The calling thread is worker 0
+    for (unsigned i = 1; i < threads; i++)
+        _threads.emplace_back(&ParallelProcessor::_worker, this, i);
+}
+
+ParallelProcessor::~ParallelProcessor()
+{
+    {
+        std::lock_guard<std::mutex> lock(_tick_lock);
+        _stopping = true;
+    }
+    _tick_start.notify_all();
+
+    for (std::thread &thread : _threads)
+        thread.join();
+}
+
+bool ParallelProcessor::depends_on(Processable *after, Processable *before)
+{
+    if (after == before || _reaches(after, before))
+        return false;
+
+    _after[before].push_back(after);
+    return true;
+}
+
+bool ParallelProcessor::_reaches(Processable *from, Processable *to) const
+{
+    std::vector<Processable *> stack(1, from);
+    std::unordered_map<Processable *, bool> seen;
+
+    while (!stack.empty()) {
+        Processable *item = stack.back();
+        stack.pop_back();
+        if (item == to)
+            return true;
+        if (seen[item])
+            continue;
+        seen[item] = true;
+
+        auto found = _after.find(item);
+        if (found != _after.end())
+            stack.insert(stack.end(), found->second.begin(), found->second.end());
+    }
+    return false;
+}
+
+void ParallelProcessor::process()
+{
+    uint32_t now = (uint32_t)micros();
+    _processor._take_due(now);
+
+    size_t count = _processor._due.count();
+    if (count == 0) {
+        _processor._finish_due(now);
+        _processor._deliver();
+        return;
+    }
+
+    // Wire up the orderings between things due this tick
+    _index.clear();
+    for (size_t i = 0; i < count; i++)
+        _index[_processor._due[i]] = i;
+
+    if (_waiting_size < count) {
+        _waiting.reset(new std::atomic<uint32_t>[count]);
+        _waiting_size = count;
+    }
+    _successors.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        _successors[i].clear();
+        _waiting[i].store(0, std::memory_order_relaxed);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        auto found = _after.find(_processor._due[i]);
+        if (found == _after.end())
+            continue;
+
+        for (Processable *after : found->second) {
+            auto next = _index.find(after);
+            if (next == _index.end())
+                continue; // Not due this tick
+            _successors[i].push_back(next->second);
+            _waiting[next->second].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Pick the starting set before any of it is visible, a worker
+    // still spinning from the last tick may start on it right away
+    _ready.clear();
+    for (size_t i = 0; i < count; i++) {
+        if (_waiting[i].load(std::memory_order_relaxed) == 0)
+            _ready.push_back(i);
+    }
+
+    _now = now;
+    _remaining.store(count, std::memory_order_release);
+
+    for (size_t i = 0; i < _ready.size(); i++)
+        _push((unsigned)(i % _queues.size()), _ready[i]);
+
+    {
+        std::lock_guard<std::mutex> lock(_tick_lock);
+        _generation++;
+    }
+    _tick_start.notify_all();
+
+    _run_tick(0);
+
+    // Barrier passed, every process() has returned
+    _processor._finish_due(now);
+    _processor._deliver(); // Posted events, from this thread only
+}
+
+void ParallelProcessor::_worker(unsigned self)
+{
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_tick_lock);
+            _tick_start.wait(lock, [&] {
+                return _stopping || _generation != seen;
+            });
+            if (_stopping)
+                return;
+            seen = _generation;
+        }
+        _run_tick(self);
+    }
+}
+
+void ParallelProcessor::_run_tick(unsigned self)
+{
+    while (_remaining.load(std::memory_order_acquire) > 0) {
+        size_t task;
+        if (_pop(self, task) || _steal(self, task)) {
+            _processor._execute(task, _now);
+            _finished(self, task);
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void ParallelProcessor::_push(unsigned self, size_t task)
+{
+    Queue &queue = *_queues[self];
+    std::lock_guard<std::mutex> lock(queue.lock);
+    queue.tasks.push_back(task);
+}
+
+bool ParallelProcessor::_pop(unsigned self, size_t &task)
+{
+    // Newest first, what we just unblocked is likely still in cache
+    Queue &queue = *_queues[self];
+    std::lock_guard<std::mutex> lock(queue.lock);
+    if (queue.tasks.empty())
+        return false;
+
+    task = queue.tasks.back();
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool ParallelProcessor::_steal(unsigned self, size_t &task)
+{
+    // Oldest first from everyone else
+    for (size_t i = 1; i < _queues.size(); i++) {
+        Queue &queue = *_queues[(self + i) % _queues.size()];
+        std::lock_guard<std::mutex> lock(queue.lock);
+        if (queue.tasks.empty())
+            continue;
+
+        task = queue.tasks.front();
+        queue.tasks.pop_front();
+        _steals.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void ParallelProcessor::_finished(unsigned self, size_t task)
+{
+    for (size_t next : _successors[task]) {
+        if (_waiting[next].fetch_sub(1, std::memory_order_acq_rel) == 1)
+            _push(self, next);
+    }
+
+    // Last, the tick may end (and its state be rebuilt) right after
+    _remaining.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+}
+}
@@ -0,0 +1,113 @@
+/*
+    Host (BUILD_LIB) executor that runs a Processor's due Processables
+    on a pool of threads, for gateways and simulations with hundreds
+    of them.
+
+    Each tick takes what's due from the Processor, exactly as
+    Processor::process() would, and runs those process() calls on
+    every thread at once. Each thread works from its own deque and
+    steals from the others when it runs dry. process() returns once
+    they've all finished (a barrier), then the Processor reschedules
+    them as usual.
+
+    .. code-block:: cpp
+
+        lutil::host::ParallelProcessor parallel; // A thread per core
+
+        // The controller reads what the sensor wrote this tick
+        parallel.depends_on(&controller, &sensor);
+
+        parallel.init();
+        while (running)
+            parallel.process();
+
+    Only Processables with no ordering between them run concurrently,
+    so process() must not touch state shared with another Processable
+    unless a dependency orders the two. From inside process(), only
+    schedule yourself (set_period(), wake_in(), sleep()).
+*/
+#pragma once
+#include "lutil.h"
+#include "lu_process/process.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace lutil {
+namespace host {
+
+class ParallelProcessor {
+public:
+    // threads includes the one calling process(), 0 for one per core
+    explicit ParallelProcessor(
+        unsigned threads = 0,
+        Processor &processor = Processor::get()
+    );
+    ~ParallelProcessor();
+
+    ParallelProcessor(const ParallelProcessor &) = delete;
+    ParallelProcessor &operator=(const ParallelProcessor &) = delete;
+
+    /*
+        When both are due in the same tick, before finishes its
+        process() ahead of after starting. Returns false (and adds
+        nothing) when that would make a cycle.
+    */
+    bool depends_on(Processable *after, Processable *before);
+
+    void init() { _processor.init(); }
+
+    // One tick, returns once every due Processable has run
+    void process();
+
+    unsigned threads() const { return (unsigned)_queues.size(); }
+
+    // Tasks taken from another thread's deque, since construction
+    uint64_t steals() const { return _steals.load(); }
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<size_t> tasks; // Indices into the Processor's due list
+    };
+
+    void _worker(unsigned self);
+    void _run_tick(unsigned self);
+    bool _pop(unsigned self, size_t &task);
+    bool _steal(unsigned self, size_t &task);
+    void _push(unsigned self, size_t task);
+    void _finished(unsigned self, size_t task);
+    bool _reaches(Processable *from, Processable *to) const;
+
+    Processor &_processor;
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _threads;
+
+    // Declared orderings, before -> everything after it
+    std::unordered_map<Processable *, std::vector<Processable *>> _after;
+
+    // The tick in progress
+    uint32_t _now;
+    std::unordered_map<Processable *, size_t> _index;
+    std::vector<std::vector<size_t>> _successors;
+    std::unique_ptr<std::atomic<uint32_t>[]> _waiting; // Predecessors left
+    std::vector<size_t> _ready; // Nothing to wait for
+    size_t _waiting_size;
+    std::atomic<size_t> _remaining;
+
+    std::mutex _tick_lock;
+    std::condition_variable _tick_start;
+    uint64_t _generation;
+    bool _stopping;
+
+    std::atomic<uint64_t> _steals;
+};
+
+}
+}
@@ -169,7 +169,7 @@ void TimeCounter::process()
         {
             // We're going to wrap, set to zero
             if (_milliseconds != 0)
-                event(Zero);
+                post(Zero);
             _milliseconds = 0;
         }
         else
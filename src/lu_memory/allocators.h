@@ -0,0 +1,284 @@
+/*
+    Memory resources and the typed allocators that plug them into
+    Vec (and Map) via the allocator template parameter.
+
+    .. code-block:: cpp
+
+        // One arena for everything built during a frame
+        lutil::StaticArena<1024> frame_arena;
+
+        {
+            // Braces, with parentheses this declares a function
+            lutil::Vec<uint8_t, lutil::ArenaAlloc<uint8_t>> bytes{
+                lutil::ArenaAlloc<uint8_t>(frame_arena)
+            };
+            bytes.push(0x7E);
+        }
+
+        frame_arena.reset(); // O(1), once the containers are gone
+*/
+#pragma once
+#include "lutil.h"
+#include "lu_memory/utility.h"
+#include "lu_storage/vector.h"
+
+namespace lutil {
+
+union _max_align {
+    long double d;
+    long long l;
+    void *p;
+    void (*f)();
+};
+
+#define LUTIL_MAX_ALIGN alignof(lutil::_max_align)
+
+/*
+    Bump allocator over a caller provided buffer. Allocations are a
+    pointer bump and everything is freed at once with reset().
+
+    deallocate() only gives memory back when it was the most recent
+    allocation (LIFO). A growing Vec isn't that: it allocates the new
+    block before letting go of the old one, so every block it grows
+    out of stays used until reset().
+*/
+class Arena {
+public:
+    Arena(void *buffer, size_t size)
+        : _buffer((uint8_t *)buffer)
+        , _size(size)
+        , _used(0)
+    {}
+
+    void *allocate(size_t size, size_t align = LUTIL_MAX_ALIGN) {
+        uintptr_t start = (uintptr_t)(_buffer + _used);
+        uintptr_t aligned = (start + align - 1) & ~(uintptr_t)(align - 1);
+        size_t offset = (size_t)(aligned - (uintptr_t)_buffer);
+
+        if (offset + size > _size)
+            return nullptr; // Exhausted
+
+        _used = offset + size;
+        return _buffer + offset;
+    }
+
+    void deallocate(void *data, size_t size) {
+        if ((uint8_t *)data + size == _buffer + _used)
+            _used = (size_t)((uint8_t *)data - _buffer);
+    }
+
+    // Free everything in O(1)
+    void reset() { _used = 0; }
+
+    bool owns(const void *data) const {
+        return data >= _buffer && data < _buffer + _size;
+    }
+
+    size_t used() const { return _used; }
+    size_t capacity() const { return _size; }
+
+private:
+    uint8_t *_buffer;
+    size_t _size;
+    size_t _used;
+};
+
+
+/* Arena with its buffer inline (global/static use) */
+template<size_t N>
+class StaticArena : public Arena {
+public:
+    StaticArena()
+        : Arena(_buffer, N)
+    {}
+
+    StaticArena(const StaticArena &) = delete;
+    StaticArena &operator= (const StaticArena &) = delete;
+
+private:
+    alignas(LUTIL_MAX_ALIGN) uint8_t _buffer[N];
+};
+
+
+/*
+    Arena meant to be declared on the stack for scratch work. Falls
+    back to the heap once the inline buffer runs out so it never
+    fails outright.
+*/
+template<size_t N>
+class StackArena : public Arena {
+public:
+    StackArena()
+        : Arena(_buffer, N)
+    {}
+
+    StackArena(const StackArena &) = delete;
+    StackArena &operator= (const StackArena &) = delete;
+
+    void *allocate(size_t size, size_t align = LUTIL_MAX_ALIGN) {
+        void *data = Arena::allocate(size, align);
+        if (!data)
+            data = new uint8_t[size];
+        return data;
+    }
+
+    void deallocate(void *data, size_t size) {
+        if (owns(data))
+            Arena::deallocate(data, size);
+        else
+            delete [] (uint8_t *)data;
+    }
+
+private:
+    alignas(LUTIL_MAX_ALIGN) uint8_t _buffer[N];
+};
+
+
+/*
+    Pool of equally sized blocks carved out of a caller provided
+    buffer. Allocate and free are O(1) through an intrusive free list
+    and the pool never fragments.
+
+    Requests larger than the block size fail (nullptr).
+*/
+class BlockPool {
+public:
+    BlockPool(void *buffer, size_t size, size_t block_size)
+        : _free(nullptr)
+        , _block_size(_round(block_size))
+        , _available(0)
+    {
+        uintptr_t start = (uintptr_t)buffer;
+        uintptr_t aligned = (start + LUTIL_MAX_ALIGN - 1) & ~(uintptr_t)(LUTIL_MAX_ALIGN - 1);
+        size_t slack = (size_t)(aligned - start);
+        size = (size > slack) ? size - slack : 0; // Too small, empty pool
+
+        uint8_t *block = (uint8_t *)aligned;
+        for (size_t i = 0; i + _block_size <= size; i += _block_size) {
+            _push(block + i);
+        }
+    }
+
+    void *allocate(size_t size, size_t align = LUTIL_MAX_ALIGN) {
+        if (size > _block_size || align > LUTIL_MAX_ALIGN || !_free)
+            return nullptr;
+
+        _Node *node = _free;
+        _free = node->next;
+        _available--;
+        return node;
+    }
+
+    void deallocate(void *data, size_t) {
+        if (data)
+            _push(data);
+    }
+
+    size_t block_size() const { return _block_size; }
+    size_t available() const { return _available; }
+
+private:
+    struct _Node {
+        _Node *next;
+    };
+
+    static size_t _round(size_t size) {
+        if (size < sizeof(_Node))
+            size = sizeof(_Node);
+        return (size + LUTIL_MAX_ALIGN - 1) & ~(size_t)(LUTIL_MAX_ALIGN - 1);
+    }
+
+    void _push(void *data) {
+        _Node *node = (_Node *)data;
+        node->next = _free;
+        _free = node;
+        _available++;
+    }
+
+    _Node *_free;
+    size_t _block_size;
+    size_t _available;
+};
+
+
+/* BlockPool with COUNT blocks of BLOCK bytes inline */
+template<size_t BLOCK, size_t COUNT>
+class StaticPool : public BlockPool {
+public:
+    StaticPool()
+        : BlockPool(_buffer, sizeof(_buffer), BLOCK)
+    {}
+
+    StaticPool(const StaticPool &) = delete;
+    StaticPool &operator= (const StaticPool &) = delete;
+
+private:
+    alignas(LUTIL_MAX_ALIGN) uint8_t _buffer[
+        ((BLOCK + LUTIL_MAX_ALIGN - 1) / LUTIL_MAX_ALIGN) * LUTIL_MAX_ALIGN * COUNT
+    ];
+};
+
+
+/*
+    Typed allocator over any of the resources above. Matches the Alloc
+    interface so it can be handed to Vec as A. Elements are built in
+    place on allocate and torn down on deallocate.
+
+    A default constructed allocator has no resource and fails every
+    allocation, so always construct the container with one.
+*/
+template<typename T, typename R>
+class ResourceAlloc : public Alloc<T> {
+public:
+    ResourceAlloc()
+        : _resource(nullptr)
+    {}
+
+    ResourceAlloc(R &resource)
+        : _resource(&resource)
+    {}
+
+    T *allocate(size_t size) {
+        T *data = (T *)allocate_bytes(size * sizeof(T), alignof(T));
+        if (data) {
+            for (size_t i = 0; i < size; i++)
+                construct_at<T>(data + i);
+        }
+        return data;
+    }
+
+    void deallocate(T *data, size_t size) {
+        if (!data)
+            return;
+        for (size_t i = 0; i < size; i++)
+            destroy_at(data + i);
+        deallocate_bytes(data, size * sizeof(T));
+    }
+
+    void *allocate_bytes(size_t size, size_t align) {
+        if (!_resource)
+            return nullptr;
+        return _resource->allocate(size, align);
+    }
+
+    void deallocate_bytes(void *data, size_t size) {
+        if (_resource && data)
+            _resource->deallocate(data, size);
+    }
+
+    R *resource() const { return _resource; }
+
+private:
+    R *_resource;
+};
+
+template<typename T>
+using ArenaAlloc = ResourceAlloc<T, Arena>;
+
+template<typename T>
+using PoolAlloc = ResourceAlloc<T, BlockPool>;
+
+template<typename T, size_t N>
+using StackAlloc = ResourceAlloc<T, StackArena<N>>;
+
+}
@@ -1,25 +1,93 @@
 #pragma once
 #include "lutil.h"
+#include "lu_memory/utility.h"
+#include "lu_storage/hash.h"
+
+#ifdef BUILD_LIB
+#include <atomic>
+#endif
 
 namespace lutil {
 
-template<typename T>
-inline void swap_ptr(T **a, T **b)
-{
-    T *temp = *a;
-    *a = *b;
-    *b = temp;
-}
+/*
+    Reference count policies for managed_ptr. The count is the second
+    template parameter:
+
+    - ref_count        : plain int, the default. Fine for the single
+                         threaded loop() world of a uC
+    - atomic_ref_count : host builds only, for pointers that are
+                         shared between threads
+    - intrusive_count  : the object carries its own count (derive from
+                         managed_object) so no control block is needed
+*/
+struct ref_count {
+    ref_count(int start = 1) : _count(start) {}
 
-template<typename T>
-inline void swap_val(T &a, T &b)
-{
-    T temp = a;
-    a = b;
-    b = temp;
-}
+    void increment() { ++_count; }
+    int decrement() { return --_count; }
+    int count() const { return _count; }
 
-template<class T>
+private:
+    int _count;
+};
+
+#ifdef BUILD_LIB
+struct atomic_ref_count {
+    atomic_ref_count(int start = 1) : _count(start) {}
+
+    void increment() { _count.fetch_add(1, std::memory_order_relaxed); }
+
+    // The last owner has to see every write made through the others
+    int decrement() { return _count.fetch_sub(1, std::memory_order_acq_rel) - 1; }
+
+    int count() const { return _count.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int> _count;
+};
+#endif
+
+struct intrusive_count {};
+
+
+/*
+    Control block shared by every copy of a managed_ptr. kind tells
+    us how the object has to be released.
+*/
+enum : uint8_t {
+    _ManagedObject = 0, // new T, count allocated on its own
+    _ManagedArray,      // new T[], count allocated on its own
+    _ManagedInline      // make_managed(), object lives in the block
+};
+
+template<class C>
+struct _managed_block {
+    _managed_block(uint8_t k) : kind(k) {}
+
+    C refs;
+    uint8_t kind;
+};
+
+template<class T, class C>
+struct _managed_inline : public _managed_block<C> {
+    _managed_inline() : _managed_block<C>(_ManagedInline) {}
+
+    alignas(T) uint8_t storage[sizeof(T)];
+};
+
+
+/*
+    Reference counted pointer.
+
+    .. code-block:: cpp
+
+        // One allocation for both the object and its count
+        lutil::managed_ptr<Foo> foo = lutil::make_managed<Foo>(1, 2);
+
+        // Adopt an existing pointer (the count is allocated apart)
+        lutil::managed_ptr<Foo> bar(new Foo(1, 2));
+*/
+template<class T, class C = ref_count>
 class managed_ptr {
 
 public:
@@ -29,7 +97,7 @@ public:
     {}
 
     managed_ptr(T *ptr)
-        : _refs(new int(1))
+        : _refs(ptr ? new _managed_block<C>(_ManagedObject) : nullptr)
         , _ptr(ptr)
     {}
 
@@ -37,13 +105,33 @@ public:
         : _refs(ptr._refs)
         , _ptr(ptr._ptr)
     {
-        if (*this)
-            (*_refs)++;
+        if (_refs)
+            _refs->refs.increment();
+    }
+
+    // Steals the reference, the count never changes
+    managed_ptr(managed_ptr &&ptr)
+        : _refs(ptr._refs)
+        , _ptr(ptr._ptr)
+    {
+        ptr._refs = nullptr;
+        ptr._ptr = nullptr;
     }
 
     // Desconstructor cleans out reference
     ~managed_ptr() { immolate(); }
 
+    /* Build T and its count in a single allocation */
+    template<typename... Args>
+    static managed_ptr make(Args&&... args) {
+        _managed_inline<T, C> *block = new _managed_inline<T, C>();
+
+        managed_ptr output;
+        output._refs = block;
+        output._ptr = construct_at<T>(block->storage, lutil::forward<Args>(args)...);
+        return output;
+    }
+
     operator bool() const noexcept {
         return _ptr != nullptr;
     }
@@ -60,101 +148,354 @@ public:
         return _ptr;
     }
 
+    // Owners sharing this object (0 when empty)
+    int use_count() const {
+        return _refs ? _refs->refs.count() : 0;
+    }
+
+    // Handles both copy and move (the argument is built either way)
     managed_ptr &operator= (managed_ptr other) {
         other.swap(*this);
         return *this;
     }
 
     void swap(managed_ptr &other) {
-        swap_ptr<int>(&_refs, &other._refs);
+        swap_ptr<_managed_block<C>>(&_refs, &other._refs);
         swap_ptr<T>(&_ptr, &other._ptr);
     }
 
+    /*
+        GCC 11+ inlines this next to a new T[] and, not knowing what
+        kind holds, warns about the delete _ptr it can't rule out
+        (-Wmismatched-new-delete). kind always matches the allocation.
+    */
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
     void immolate() {
-        if (*this) {
-            --(*_refs);
-
-            if (*_refs <= 0) {
+        if (_refs && _refs->refs.decrement() <= 0) {
+            switch (_refs->kind) {
+            case _ManagedArray:
+                delete [] _ptr;
                 delete _refs;
+                break;
+            case _ManagedInline:
+                destroy_at(_ptr);
+                delete static_cast<_managed_inline<T, C> *>(_refs);
+                break;
+            default:
                 delete _ptr;
+                delete _refs;
+                break;
             }
-
-            _refs = nullptr;
-            _ptr = nullptr;
         }
+        _refs = nullptr;
+        _ptr = nullptr;
     }
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
 
     void reset(T *new_data) {
-        if (*this) {
-            immolate();
+        _adopt(new_data, _ManagedObject);
+    }
+
+    // Take ownership of a new T[] (released with delete [])
+    void reset_array(T *new_data) {
+        _adopt(new_data, _ManagedArray);
+    }
+
+private:
+    void _adopt(T *new_data, uint8_t kind) {
+        immolate();
+        if (new_data) {
+            _refs = new _managed_block<C>(kind);
+            _ptr = new_data;
         }
-        _refs = new int(1);
-        _ptr = new_data;
+    }
+
+    _managed_block<C> *_refs;
+    T *_ptr;
+
+};
+
+
+/*
+    Intrusive count. Derive from this and managed_ptr<T, intrusive_count>
+    keeps the count inside the object itself - no control block and
+    a managed_ptr the size of a raw pointer.
+
+    .. code-block:: cpp
+
+        struct Node : public lutil::managed_object<> { ... };
+
+        lutil::managed_ptr<Node, lutil::intrusive_count> node(new Node());
+
+    A raw Node * can be wrapped again at any time and shares the same
+    count. C picks the counter (ref_count or atomic_ref_count).
+*/
+template<class C = ref_count>
+class managed_object {
+public:
+    managed_object() : _managed_refs(0) {}
+
+    // Copies are new objects with their own owners
+    managed_object(const managed_object &) : _managed_refs(0) {}
+    managed_object &operator= (const managed_object &) { return *this; }
+
+private:
+    template<class, class> friend class managed_ptr;
+
+    mutable C _managed_refs;
+};
+
+
+template<class T>
+class managed_ptr<T, intrusive_count> {
+
+public:
+    managed_ptr()
+        : _ptr(nullptr)
+    {}
+
+    managed_ptr(T *ptr)
+        : _ptr(ptr)
+    {
+        if (_ptr)
+            _ptr->_managed_refs.increment();
+    }
+
+    managed_ptr(const managed_ptr &ptr)
+        : _ptr(ptr._ptr)
+    {
+        if (_ptr)
+            _ptr->_managed_refs.increment();
+    }
+
+    managed_ptr(managed_ptr &&ptr)
+        : _ptr(ptr._ptr)
+    {
+        ptr._ptr = nullptr;
+    }
+
+    ~managed_ptr() { immolate(); }
+
+    template<typename... Args>
+    static managed_ptr make(Args&&... args) {
+        return managed_ptr(new T(lutil::forward<Args>(args)...));
+    }
+
+    operator bool() const noexcept {
+        return _ptr != nullptr;
+    }
+
+    T *operator ->() const {
+        return _ptr;
+    }
+
+    T &operator *() const {
+        return *_ptr;
+    }
+
+    T *get() const {
+        return _ptr;
+    }
+
+    int use_count() const {
+        return _ptr ? _ptr->_managed_refs.count() : 0;
+    }
+
+    managed_ptr &operator= (managed_ptr other) {
+        other.swap(*this);
+        return *this;
+    }
+
+    void swap(managed_ptr &other) {
+        swap_ptr<T>(&_ptr, &other._ptr);
+    }
+
+    void immolate() {
+        if (_ptr && _ptr->_managed_refs.decrement() <= 0)
+            delete _ptr;
+        _ptr = nullptr;
+    }
+
+    void reset(T *new_data) {
+        managed_ptr(new_data).swap(*this);
     }
 
 private:
-    int *_refs;
     T *_ptr;
 
 };
 
 
+template<class T, class C = ref_count, typename... Args>
+inline managed_ptr<T, C> make_managed(Args&&... args) {
+    return managed_ptr<T, C>::make(lutil::forward<Args>(args)...);
+}
+
+
+#ifndef LUTIL_SSO_SIZE
+#define LUTIL_SSO_SIZE 15 // Characters kept inline before we go to the heap
+#endif
+
 /*
     Lightweight system for handling fixed length character sets
+
+    Strings up to LUTIL_SSO_SIZE characters live inside the object
+    itself (state names, ini keys, ...) and never touch the heap.
+    Longer strings are shared between copies through managed_ptr
+    until one of them is written to through get().
+
+    The length is always known so comparisons check it first, and
+    the hash is computed once and kept for HashMap lookups.
 */
 class managed_string : public managed_ptr<char> {
 public:
     managed_string()
         : managed_ptr()
         , _size(0)
+        , _capacity(LUTIL_SSO_SIZE)
+        , _hash(0)
     {
+        _local[0] = '\0';
     }
 
     managed_string(const char *data)
-        : managed_ptr()
-        , _size(0)
+        : managed_string()
     {
         *this = data; // Let the operator have it
     }
 
+    // Zeroed buffer of size characters to be filled through get()
     explicit managed_string(size_t size)
-        : managed_ptr(new char[size + 1])
-        , _size(size)
+        : managed_string()
     {
+        _reserve(size);
+        _size = size;
         memset(get(), '\0', _size + 1);
     }
 
+    managed_string(const managed_string &other) = default;
+    managed_string &operator= (const managed_string &other) = default;
+
     bool operator==(const char *data) const {
-        return (strncmp(c_str(), data, _size) == 0);
+        if (!data)
+            return _size == 0;
+
+        // Equal up to our length and the other one ends there too
+        return (strncmp(c_str(), data, _size) == 0 && data[_size] == '\0');
     }
 
     bool operator==(const managed_string &other) const {
         if (_size != other._size)
             return false;
-        return (strncmp(c_str(), other.c_str(), _size) == 0);
+        if (_hash && other._hash && _hash != other._hash)
+            return false;
+        return (memcmp(c_str(), other.c_str(), _size) == 0);
+    }
+
+    bool operator!=(const char *data) const { return !(*this == data); }
+    bool operator!=(const managed_string &other) const { return !(*this == other); }
+
+    // Ordering for sorted containers (FlatMap)
+    bool operator<(const managed_string &other) const {
+        return strcmp(c_str(), other.c_str()) < 0;
     }
 
+    // data may point into our own characters (s = s.c_str() + 4)
     managed_string &operator= (const char *data) {
-        if (strlen(data) > _size) {
-            // We need to expand
-            _size = strlen(data);
-            reset(new char[_size + 1]);
-        }
-        if (_size > 0) {
-            ::memset(get(), '\0', _size + 1);
-            ::memcpy(get(), data, _size);
+        size_t size = data ? strlen(data) : 0;
+
+        // Going inline lets go of the heap buffer data is in, keep
+        // the characters on the stack until they're copied over
+        char scratch[LUTIL_SSO_SIZE + 1];
+        const char *heap = managed_ptr::get();
+        if (heap && size <= LUTIL_SSO_SIZE && data >= heap && data <= heap + _size) {
+            ::memcpy(scratch, data, size);
+            data = scratch;
         }
+
+        _reserve(size);
+        _size = size;
+        ::memmove(get(), data ? data : "", _size);
+        get()[_size] = '\0';
         return *this;
     }
 
-    const char *c_str() const { return get(); }
+    // Never nullptr, an empty string is ""
+    const char *c_str() const {
+        const char *heap = managed_ptr::get();
+        return heap ? heap : _local;
+    }
+
+    const char *get() const { return c_str(); }
+
+    /*
+        Writing through here is allowed. Copies share a heap buffer,
+        so a shared one is copied first and the others (and their
+        cached hashes) never see the write.
+    */
+    char *get() {
+        char *heap = managed_ptr::get();
+        if (heap && use_count() > 1) {
+            char *own = new char[_size + 1];
+            ::memcpy(own, heap, _size + 1);
+            reset_array(own);
+            _capacity = _size;
+            heap = own;
+        }
+        _hash = 0;
+        return heap ? heap : _local;
+    }
+
+    operator bool() const noexcept { return _size > 0; }
+
     size_t size() const { return _size; }
 
+    // True while the characters live inside the object
+    bool is_inline() const { return !managed_ptr::get(); }
+
+    uint32_t hash() const {
+        if (_hash == 0)
+            _hash = hash_string(c_str());
+        return _hash;
+    }
+
 private:
+    // Room for size characters that we alone own
+    void _reserve(size_t size) {
+        _hash = 0;
+        if (size <= LUTIL_SSO_SIZE) {
+            immolate();
+            _capacity = LUTIL_SSO_SIZE;
+            return;
+        }
+        if (managed_ptr::get() && use_count() == 1 && _capacity >= size)
+            return;
+
+        reset_array(new char[size + 1]);
+        _capacity = size;
+    }
+
     size_t _size;
+    size_t _capacity;
+    mutable uint32_t _hash; // 0 until someone asks
+    char _local[LUTIL_SSO_SIZE + 1];
+};
+
+template<>
+struct Hash<managed_string> {
+    static uint32_t hash(const managed_string &key) {
+        return key.hash();
+    }
 };
 
 
+class data_view;
+
 class managed_data : public managed_ptr<uint8_t> {
 public:
     managed_data()
@@ -286,9 +627,10 @@ public:
     }
 
     explicit managed_data(size_t size)
-        : managed_ptr(new uint8_t[size])
+        : managed_ptr()
         , _size(size)
     {
+        reset_array(new uint8_t[size]);
         zero();
     }
 
@@ -303,18 +645,24 @@ public:
         return *(get() + index);
     }
 
+    // Copies data. The buffer is reused when we're its only owner
+    // and the size doesn't change. data may point into our own
+    // buffer, so it's copied out before that buffer is let go.
     void reset(uint8_t *data, size_t size) {
-        _size = size;
-
-        uint8_t *d = new uint8_t[_size];
-        memcpy(d, data, _size);
+        if (get() && use_count() == 1 && size == _size) {
+            memmove(get(), data, _size);
+            return;
+        }
 
-        managed_ptr<uint8_t>::reset(d);
+        uint8_t *fresh = new uint8_t[size];
+        memcpy(fresh, data, size);
+        take(fresh, size);
     }
 
+    // Adopts data, which must come from new uint8_t[]
     void take(uint8_t *data, size_t size) {
         _size = size;
-        managed_ptr<uint8_t>::reset(data);
+        reset_array(data);
     }
 
     void zero() {
@@ -325,8 +673,101 @@ public:
 
     size_t size() const { return _size; }
 
+    // Share a sub-range of this data without copying (see data_view)
+    data_view slice(size_t offset, size_t size = (size_t)-1) const;
+
 private:
     size_t _size;
 };
 
+
+/*
+    Read-only window onto (part of) a managed_data. The view holds a
+    reference on the underlying buffer so it stays valid however long
+    it outlives the managed_data it came from, and no bytes are ever
+    copied to make one.
+
+    .. code-block:: cpp
+
+        lutil::managed_data frame = ...;
+        lutil::data_view body = frame.slice(11);  // skip the header
+        lutil::data_view head = body.slice(0, 2); // views of views
+
+    copy() detaches the bytes when a private, writable buffer is needed.
+*/
+class data_view {
+public:
+    data_view()
+        : _data()
+        , _offset(0)
+        , _size(0)
+    {}
+
+    data_view(const managed_data &data)
+        : _data(data)
+        , _offset(0)
+        , _size(data.size())
+    {}
+
+    // Clamped to whatever data actually holds
+    data_view(const managed_data &data, size_t offset, size_t size)
+        : _data(data)
+        , _offset(offset < data.size() ? offset : data.size())
+        , _size(0)
+    {
+        size_t left = data.size() - _offset;
+        _size = (size < left) ? size : left;
+    }
+
+    const uint8_t *get() const {
+        return _data.get() ? _data.get() + _offset : nullptr;
+    }
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    uint8_t operator[](size_t index) const {
+        if (index >= _size)
+            return 0; // Failsafe (same as managed_data)
+        return get()[index];
+    }
+
+    const uint8_t *begin() const { return get(); }
+    const uint8_t *end() const { return get() + _size; }
+
+    data_view slice(size_t offset, size_t size = (size_t)-1) const {
+        if (offset > _size)
+            offset = _size;
+        if (size > _size - offset)
+            size = _size - offset;
+        return data_view(_data, _offset + offset, size);
+    }
+
+    // The buffer this view shares
+    const managed_data &owner() const { return _data; }
+
+    // A private copy of just these bytes
+    managed_data copy() const {
+        managed_data output(_size);
+        if (_size)
+            memcpy(output.get(), get(), _size);
+        return output;
+    }
+
+    bool operator==(const data_view &other) const {
+        if (_size != other._size)
+            return false;
+        return _size == 0 || memcmp(get(), other.get(), _size) == 0;
+    }
+
+private:
+    managed_data _data;
+    size_t _offset;
+    size_t _size;
+};
+
+inline data_view managed_data::slice(size_t offset, size_t size) const {
+    return data_view(*this, offset, size);
+}
+
 }
\ No newline at end of file
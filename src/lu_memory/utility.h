@@ -0,0 +1,95 @@
+/*
+    Minimal stand-ins for the handful of <utility> helpers we need.
+    Most uC toolchains ship without the STL so we keep our own.
+*/
+#pragma once
+#include "lutil.h"
+
+namespace lutil {
+
+template<typename T> struct remove_reference { typedef T type; };
+template<typename T> struct remove_reference<T &> { typedef T type; };
+template<typename T> struct remove_reference<T &&> { typedef T type; };
+
+/* Cast to an rvalue so the move operations (if any) get picked */
+template<typename T>
+inline typename remove_reference<T>::type &&move(T &&value) {
+    return static_cast<typename remove_reference<T>::type &&>(value);
+}
+
+/* Perfect forwarding for variadic constructors */
+template<typename T>
+inline T &&forward(typename remove_reference<T>::type &value) {
+    return static_cast<T &&>(value);
+}
+
+template<typename T>
+inline T &&forward(typename remove_reference<T>::type &&value) {
+    return static_cast<T &&>(value);
+}
+
+template<typename T>
+inline void swap_ptr(T **a, T **b)
+{
+    T *temp = *a;
+    *a = *b;
+    *b = temp;
+}
+
+template<typename T>
+inline void swap_val(T &a, T &b)
+{
+    T temp = lutil::move(a);
+    a = lutil::move(b);
+    b = lutil::move(temp);
+}
+
+/* Overload selector for compile time branches */
+template<bool B>
+struct bool_tag {};
+
+/*
+    Types we can relocate with a memcpy. Every compiler we target
+    has the builtin, even without <type_traits>.
+*/
+template<typename T>
+struct is_trivially_copyable {
+    static constexpr bool value = __is_trivially_copyable(T);
+};
+
+/* Compile time checks for overloads (std::enable_if, std::is_same) */
+template<bool B, typename T = void> struct enable_if {};
+template<typename T> struct enable_if<true, T> { typedef T type; };
+
+template<typename A, typename B> struct is_same { static constexpr bool value = false; };
+template<typename T> struct is_same<T, T> { static constexpr bool value = true; };
+
+/* A T to reason about in unevaluated contexts (std::declval) */
+template<typename T>
+T &&declval();
+
+/* Tag for our own placement new (not every core ships <new>) */
+struct placement_tag {};
+
+}
+
+inline void *operator new(size_t, lutil::placement_tag, void *where) {
+    return where;
+}
+
+inline void operator delete(void *, lutil::placement_tag, void *) {}
+
+namespace lutil {
+
+/* Build a T inside raw storage */
+template<typename T, typename... Args>
+inline T *construct_at(void *where, Args&&... args) {
+    return new (placement_tag(), where) T(lutil::forward<Args>(args)...);
+}
+
+template<typename T>
+inline void destroy_at(T *item) {
+    item->~T();
+}
+
+}
@@ -85,7 +85,7 @@ public:
                 if (read == LOW) {
                     _active_state = ButtonState::Released;
                     released();
-                    event(int(_active_state));
+                    post(int(_active_state));
                 }
                 break;
             }
@@ -94,7 +94,7 @@ public:
                 if (read == HIGH) {
                     _active_state = ButtonState::Pressed;
                     pressed();
-                    event(int(_active_state));
+                    post(int(_active_state));
                 }
                 break;
             }
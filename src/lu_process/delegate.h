@@ -0,0 +1,92 @@
+/*
+    A callable that lives inline: function pointers, object + member
+    function, and lambdas with small captures, without allocating.
+
+    .. code-block:: cpp
+
+        lutil::Delegate<void()> a = toggle_led;              // free function
+        lutil::Delegate<void()> b(&motor, &Motor::stop);     // member
+        lutil::Delegate<void(int)> c = [&counter](int n) {   // lambda
+            counter += n;
+        };
+        c(3);
+
+    Whatever it holds is copied around as plain bytes, so it has to be
+    trivially copyable (capture pointers and numbers, not objects that
+    own memory) and fit in SIZE bytes. Both are checked at compile
+    time. The default fits an object pointer plus a member function
+    pointer.
+*/
+#pragma once
+#include "lutil.h"
+#include "lu_memory/utility.h"
+
+#ifndef LUTIL_DELEGATE_SIZE
+#define LUTIL_DELEGATE_SIZE (3 * sizeof(void *))
+#endif
+
+namespace lutil {
+
+template<typename SIGNATURE, size_t SIZE = LUTIL_DELEGATE_SIZE>
+class Delegate;
+
+template<typename R, typename... Args, size_t SIZE>
+class Delegate<R(Args...), SIZE> {
+public:
+    Delegate() : _invoke(nullptr) {}
+
+    // Only callables that take Args, so overloads stay unambiguous
+    template<
+        typename F,
+        typename = typename enable_if<!is_same<F, Delegate>::value>::type,
+        typename = decltype(lutil::declval<F &>()(lutil::declval<Args>()...))
+    >
+    Delegate(F callable)
+        : _invoke(&_call<F>)
+    {
+        static_assert(sizeof(F) <= SIZE,
+            "Callable doesn't fit the Delegate, capture less (or a pointer to it)");
+        static_assert(alignof(F) <= alignof(void *),
+            "Callable needs more alignment than the Delegate has");
+        static_assert(is_trivially_copyable<F>::value,
+            "Delegates hold trivially copyable callables, capture pointers not owners");
+        construct_at<F>(_storage, lutil::move(callable));
+    }
+
+    template<typename T>
+    Delegate(T *object, R (T::*method)(Args...))
+        : Delegate(_Method<T, R (T::*)(Args...)>{object, method})
+    {}
+
+    template<typename T>
+    Delegate(const T *object, R (T::*method)(Args...) const)
+        : Delegate(_Method<const T, R (T::*)(Args...) const>{object, method})
+    {}
+
+    explicit operator bool() const { return _invoke != nullptr; }
+
+    R operator()(Args... args) const {
+        return _invoke(_storage, lutil::forward<Args>(args)...);
+    }
+
+private:
+    template<typename T, typename M>
+    struct _Method {
+        T *object;
+        M method;
+
+        R operator()(Args... args) const {
+            return (object->*method)(lutil::forward<Args>(args)...);
+        }
+    };
+
+    template<typename F>
+    static R _call(void *storage, Args... args) {
+        return (*static_cast<F *>(storage))(lutil::forward<Args>(args)...);
+    }
+
+    alignas(void *) mutable unsigned char _storage[SIZE];
+    R (*_invoke)(void *, Args...);
+};
+
+}
@@ -0,0 +1,209 @@
+/*
+    Bounded lock-free queues for handing events from one context to
+    another: an interrupt to loop(), or (on host builds) a worker
+    thread to the Processor.
+
+    .. code-block:: cpp
+
+        lutil::SpscQueue<uint16_t, 32> samples;
+
+        void adc_isr() {
+            samples.push(ADC);   // Never blocks, false when full
+        }
+
+        void loop() {
+            uint16_t sample;
+            while (samples.pop(sample))
+                filter.add(sample);
+        }
+
+    SpscQueue is safe for exactly one producer and one consumer at a
+    time. MpscQueue (host builds only) takes any number of producer
+    threads. Both hold N items (a power of two) and never allocate.
+*/
+#pragma once
+#include "lutil.h"
+
+#ifdef BUILD_LIB
+#include <atomic>
+#endif
+
+#ifndef LUTIL_EVENT_QUEUE
+#define LUTIL_EVENT_QUEUE 16 // Events the Processor can hold undelivered
+#endif
+
+#ifndef LUTIL_ISR_EVENT_QUEUE
+#define LUTIL_ISR_EVENT_QUEUE 8 // Of those, posted from interrupts
+#endif
+
+#ifndef LUTIL_EVENT_BUDGET
+#define LUTIL_EVENT_BUDGET 8 // Events the Processor delivers per process()
+#endif
+
+namespace lutil {
+
+class Processable;
+
+/* What Processable::post() (and post_from_isr()) queue up */
+struct Event {
+    Processable *source;
+    int trigger;
+    uint32_t payload;
+};
+
+/*
+    A byte index written by one side and read by the other. Host
+    builds use std::atomic. On a uC a byte store is atomic already and
+    an interrupt runs on the same core, so keeping the compiler from
+    reordering around it is all it takes.
+*/
+struct SharedIndex {
+#ifdef BUILD_LIB
+    uint8_t load() const { return _value.load(std::memory_order_acquire); }
+    uint8_t peek() const { return _value.load(std::memory_order_relaxed); }
+    void store(uint8_t value) { _value.store(value, std::memory_order_release); }
+
+    std::atomic<uint8_t> _value{0};
+#else
+    uint8_t load() const {
+        uint8_t value = _value;
+        __asm__ __volatile__("" ::: "memory");
+        return value;
+    }
+    uint8_t peek() const { return _value; }
+    void store(uint8_t value) {
+        __asm__ __volatile__("" ::: "memory");
+        _value = value;
+    }
+
+    volatile uint8_t _value = 0;
+#endif
+};
+
+/*
+    Single producer, single consumer ring. The indices run freely and
+    wrap at 256, which is why N tops out at 128.
+*/
+template<typename T, size_t N>
+class SpscQueue {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of two");
+    static_assert(N <= 128, "N is at most 128");
+
+public:
+    // Producer side. False (and counted) when full.
+    bool push(const T &item) {
+        uint8_t head = _head.peek();
+        if ((uint8_t)(head - _tail.load()) == N) {
+            _dropped++;
+            return false;
+        }
+
+        _items[head & (N - 1)] = item;
+        _head.store((uint8_t)(head + 1));
+        return true;
+    }
+
+    // Consumer side. False when empty.
+    bool pop(T &item) {
+        uint8_t tail = _tail.peek();
+        if (tail == _head.load())
+            return false;
+
+        item = _items[tail & (N - 1)];
+        _tail.store((uint8_t)(tail + 1));
+        return true;
+    }
+
+    // Either side gets an answer that was true a moment ago
+    size_t count() const { return (uint8_t)(_head.load() - _tail.load()); }
+    bool empty() const { return count() == 0; }
+    static constexpr size_t capacity() { return N; }
+
+    // Pushes refused for lack of room. Written by the producer only.
+    uint32_t dropped() const { return _dropped; }
+
+private:
+    T _items[N];
+    SharedIndex _head; // Next to write, producer owned
+    SharedIndex _tail; // Next to read, consumer owned
+    volatile uint32_t _dropped = 0;
+};
+
+#ifdef BUILD_LIB
+/*
+    Multiple producer, single consumer ring for host builds. Each slot
+    carries a sequence number (D. Vyukov's bounded queue) so producers
+    only contend on claiming a slot, never on a lock.
+*/
+template<typename T, size_t N>
+class MpscQueue {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of two");
+
+public:
+    MpscQueue() {
+        for (size_t i = 0; i < N; i++)
+            _slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    // Any thread. False (and counted) when full.
+    bool push(const T &item) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        while (true) {
+            Slot &slot = _slots[head & (N - 1)];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)head;
+
+            if (diff == 0) {
+                // Free, try to claim it
+                if (_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+                    slot.item = item;
+                    slot.sequence.store(head + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return false; // Consumer hasn't got to it yet, full
+            }
+            else {
+                head = _head.load(std::memory_order_relaxed); // Lost a race
+            }
+        }
+    }
+
+    // The one consumer. False when empty (or the oldest push is still
+    // being written).
+    bool pop(T &item) {
+        Slot &slot = _slots[_tail & (N - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != _tail + 1)
+            return false;
+
+        item = slot.item;
+        slot.sequence.store(_tail + N, std::memory_order_release);
+        _tail++;
+        return true;
+    }
+
+    size_t count() const {
+        size_t head = _head.load(std::memory_order_acquire);
+        return head > _tail ? head - _tail : 0;
+    }
+    bool empty() const { return count() == 0; }
+    static constexpr size_t capacity() { return N; }
+
+    uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    Slot _slots[N];
+    std::atomic<size_t> _head{0};  // Next to claim, producers
+    size_t _tail = 0;              // Next to read, consumer only
+    std::atomic<uint32_t> _dropped{0};
+};
+#endif
+
+}
@@ -2,6 +2,12 @@
 
 namespace lutil {
 
+// Wrap safe "a is before b" for micros() values
+static bool time_before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
 Processor &Processor::get() {
     static Processor *instance = nullptr;
     if (!instance) {
@@ -11,12 +17,54 @@ Processor &Processor::get() {
 }
 
 Processor::Processor()
+    : _order(0)
+    , _event_budget(LUTIL_EVENT_BUDGET)
+    , _current(nullptr)
 {
 }
 
 void Processor::add_processable(Processable *proc)
 {
-    _processables.push(proc);
+    if (proc->_processor == this)
+        return; // Already registered by its constructor
+
+    // Every Processable starts out in the global Processor, so this
+    // is usually a move. Both heaps can't hold it at once.
+    if (proc->_processor && !proc->_processor->_remove(proc))
+        return;
+
+    proc->_processor = this;
+    if (!_processables.push(proc))
+        return; // Full, it never runs
+
+    proc->_order = _order++;
+    proc->_wake = (uint32_t)micros();
+    _schedule(proc);
+}
+
+bool Processor::_remove(Processable *item)
+{
+    if (item->_slot == Processable::kRunning)
+        return false; // Its process() is under way, leave it be
+
+    if (item->_slot != Processable::kIdle)
+        _unschedule(item);
+
+    for (size_t i = 0; i < _processables.count(); i++) {
+        if (_processables[i] == item) {
+            _processables.pop((int)i);
+            break;
+        }
+    }
+    item->_processor = nullptr;
+    return true;
+}
+
+void Processor::reserve(size_t count)
+{
+    _processables.reserve(count);
+    _heap.reserve(count);
+    _due.reserve(count);
 }
 
 void Processor::init()
@@ -28,31 +76,326 @@ void Processor::init()
 
 void Processor::process()
 {
-    for (size_t i = 0; i < _processables.count(); i++) {
-        _processables[i]->process();
+    uint32_t now = (uint32_t)micros();
+
+    _take_due(now);
+    for (size_t i = 0; i < _due.count(); i++)
+        _execute(i, now);
+    _finish_due(now);
+    _deliver();
+}
+
+void Processor::_take_due(uint32_t now)
+{
+    // Take everything that's due off the heap first, anything that
+    // reschedules itself for "now" waits for the next process()
+    while (_heap.count() && !time_before(now, _heap[0]->_wake)) {
+        Processable *item = _heap[0];
+        _unschedule(item);
+        item->_slot = Processable::kRunning;
+        _due.push(item);
+    }
+}
+
+void Processor::_execute(size_t index, uint32_t now)
+{
+    // Something that ran before it may have put it to sleep
+    if (_due[index]->_slot == Processable::kRunning)
+        _due[index]->_execute(now);
+}
+
+void Processor::_finish_due(uint32_t now)
+{
+    for (size_t i = 0; i < _due.count(); i++)
+        _due[i]->_reschedule(now);
+
+    while (_due.count())
+        _due.pop(-1);
+}
+
+void Processor::_deliver()
+{
+    Event event;
+    for (uint16_t i = 0; i < _event_budget; i++) {
+        // Take turns, a busy interrupt can't starve the loop's posts
+        // (or the other way around)
+        bool found = (i & 1)
+            ? _isr_events.pop(event) || _events.pop(event)
+            : _events.pop(event) || _isr_events.pop(event);
+        if (!found)
+            break;
+
+        _current = &event;
+        event.source->event(event.trigger);
+    }
+    _current = nullptr;
+}
+
+uint32_t Processor::next_wake() const
+{
+    return _heap.count() ? _heap[0]->_wake : 0;
+}
+
+uint32_t Processor::idle_for() const
+{
+    if (!_events.empty() || !_isr_events.empty())
+        return 0;
+    if (!_heap.count())
+        return 0xFFFFFFFFUL;
+
+    int32_t left = (int32_t)(_heap[0]->_wake - (uint32_t)micros());
+    return left > 0 ? (uint32_t)left : 0;
+}
+
+// --------------------------------------------------------------------
+// Heap
+
+bool Processor::_before(const Processable *a, const Processable *b)
+{
+    if (a->_wake != b->_wake)
+        return time_before(a->_wake, b->_wake);
+    return a->_order < b->_order;
+}
+
+void Processor::_place(size_t index, Processable *item)
+{
+    _heap[index] = item;
+    item->_slot = (uint16_t)index;
+}
+
+void Processor::_sift_up(size_t index)
+{
+    Processable *item = _heap[index];
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        Processable *above = _heap[parent];
+        if (!_before(item, above))
+            break;
+        _place(index, above);
+        index = parent;
+    }
+    _place(index, item);
+}
+
+void Processor::_sift_down(size_t index)
+{
+    size_t count = _heap.count();
+    Processable *item = _heap[index];
+    while (true) {
+        size_t child = index * 2 + 1;
+        if (child >= count)
+            break;
+
+        // The earlier of the two children
+        Processable *next = _heap[child];
+        if (child + 1 < count) {
+            Processable *right = _heap[child + 1];
+            if (_before(right, next)) {
+                child++;
+                next = right;
+            }
+        }
+
+        if (!_before(next, item))
+            break;
+        _place(index, next);
+        index = child;
+    }
+    _place(index, item);
+}
+
+void Processor::_schedule(Processable *item)
+{
+    if (!_heap.push(item))
+        return;
+    _sift_up(_heap.count() - 1);
+}
+
+void Processor::_unschedule(Processable *item)
+{
+    size_t index = item->_slot;
+    Processable *last = _heap.pop(-1);
+    item->_slot = Processable::kIdle;
+
+    if (index < _heap.count()) {
+        _place(index, last);
+        _sift_up(index);
+        _sift_down(last->_slot);
     }
 }
 
+void Processor::_update(Processable *item)
+{
+    _sift_up(item->_slot);
+    _sift_down(item->_slot);
+}
+
+// --------------------------------------------------------------------
+
 Processable::Processable()
+    : _period(0)
+    , _wake(0)
+    , _slot(kIdle)
+    , _order(0)
+    , _rescheduled(false)
+    , _self_scheduled(false)
+    , _processor(nullptr)
 {
+    reset_stats();
     Processor::get().add_processable(this);
 }
 
-void Processable::when(int trigger, ProcessCallback callback, void *data)
+void Processable::set_period(uint32_t period)
+{
+    _period = period;
+    _self_scheduled = false;
+}
+
+void Processable::wake_at(uint32_t when)
+{
+    _wake = when;
+    _self_scheduled = (_period == 0);
+
+    if (_slot == kRunning)
+        _rescheduled = true; // Picked up once process() returns
+    else if (_slot == kIdle)
+        _processor->_schedule(this);
+    else
+        _processor->_update(this);
+}
+
+void Processable::wake_in(uint32_t delay)
 {
-    if (!_callbacks.contains(trigger)) {
-        _callbacks.insert(trigger, Vec<Callback>());
+    wake_at((uint32_t)micros() + delay);
+}
+
+void Processable::sleep()
+{
+    if (_slot != kIdle && _slot != kRunning)
+        _processor->_unschedule(this);
+    _slot = kIdle;
+}
+
+void Processable::reset_stats()
+{
+    _stats.runs = 0;
+    _stats.total_us = 0;
+    _stats.max_us = 0;
+    _stats.overruns = 0;
+    _stats.max_late_us = 0;
+}
+
+void Processable::_execute(uint32_t now)
+{
+    // Before process(), which may move _wake on. Whatever ran before
+    // us this tick may have too.
+    uint32_t late = time_before(now, _wake) ? 0 : now - _wake;
+
+    uint32_t start = (uint32_t)micros();
+    process();
+    uint32_t took = (uint32_t)micros() - start;
+
+    _stats.runs++;
+    _stats.total_us += took;
+    if (took > _stats.max_us)
+        _stats.max_us = took;
+
+    if ((_period || _self_scheduled) && late > _stats.max_late_us)
+        _stats.max_late_us = late;
+}
+
+void Processable::_reschedule(uint32_t now)
+{
+    // Cleared here rather than before process(), a wake_at() from
+    // anything that ran earlier in the tick counts too
+    bool rescheduled = _rescheduled;
+    _rescheduled = false;
+
+    if (_slot != kRunning)
+        return; // Went to sleep, or was woken onto the heap already
+
+    if (rescheduled) {
+        // wake_at() since we were taken off the heap set _wake
+    }
+    else if (_period) {
+        if (now - _wake >= _period) {
+            // Missed at least one whole period, skip what we missed
+            _stats.overruns++;
+            _wake = now + _period;
+        } else {
+            _wake += _period; // Keep the cadence, no drift
+        }
+    }
+    else if (_self_scheduled) {
+        _slot = kIdle;
+        return;
     }
-    _callbacks[trigger].push({callback, data});
+    else {
+        _wake = now; // Every process()
+    }
+
+    _slot = kIdle;
+    _processor->_schedule(this);
+}
+
+void Processable::when(int trigger, ProcessCallback callback, void *data)
+{
+    _callbacks.add(trigger, [callback, data] { callback(data); });
+}
+
+void Processable::when(int trigger, const ProcessDelegate &callback)
+{
+    _callbacks.add(trigger, callback);
+}
+
+bool Processable::post(int trigger, uint32_t payload)
+{
+    return _processor->_events.push({this, trigger, payload});
+}
+
+bool Processable::post_from_isr(int trigger, uint32_t payload)
+{
+    return _processor->_isr_events.push({this, trigger, payload});
 }
 
 void Processable::event(int trigger) {
-    if (_callbacks.contains(trigger)) {
-        auto &cb_vec = _callbacks[trigger];
-        for (size_t i = 0; i < cb_vec.count(); i++) {
-            cb_vec[i].callback(cb_vec[i].data);
-        }
+    _callbacks.call(trigger);
+}
+
+// --------------------------------------------------------------------
+
+bool CallbackTable::add(int trigger, const ProcessDelegate &callback)
+{
+    if (trigger < 0 || !callback)
+        return false;
+
+    // Every trigger up to this one gets a (maybe empty) run
+    if (_starts.count() == 0 && !_starts.push(0))
+        return false;
+    while (_starts.count() < (size_t)trigger + 2) {
+        if (!_starts.push((uint16_t)_entries.count()))
+            return false;
     }
+
+    if (!_entries.push(callback))
+        return false;
+
+    // Slide it back to the end of its trigger's run
+    size_t at = _starts[trigger + 1];
+    for (size_t i = _entries.count() - 1; i > at; i--)
+        _entries[i] = _entries[i - 1];
+    _entries[at] = callback;
+
+    for (size_t i = trigger + 1; i < _starts.count(); i++)
+        _starts[i]++;
+    return true;
+}
+
+size_t CallbackTable::count(int trigger) const
+{
+    if (trigger < 0 || (size_t)trigger + 1 >= _starts.count())
+        return 0;
+    return _starts[trigger + 1] - _starts[trigger];
 }
 
 }
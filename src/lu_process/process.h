@@ -3,26 +3,186 @@
 #include "lutil.h"
 #include "lu_storage/vector.h"
 #include "lu_storage/map.h"
+#include "lu_storage/static_vector.h"
+#include "lu_storage/static_map.h"
+#include "event_queue.h"
+#include "delegate.h"
 
 namespace lutil {
 
 class Processable;
+namespace host { class ParallelProcessor; }
 
+/*
+    Runs Processables when they're due rather than on every loop.
+
+    Each Processable has a wake time (micros()). Those are kept in a
+    min-heap so process() only touches what's due and next_wake()
+    tells the loop how long it could sleep. Processables that never
+    set a period or a wake time are due every process(), as before.
+
+    .. code-block:: cpp
+
+        void loop() {
+            auto &proc = lutil::Processor::get();
+            proc.process();
+
+            uint32_t idle = proc.idle_for();
+            if (idle > 1000)
+                delayMicroseconds(idle - 1000); // or a low power sleep
+        }
+
+    Times are compared wrap safe, any wait under ~35 minutes is fine
+    across a micros() rollover.
+
+    Events a Processable post()s are queued rather than delivered on
+    the spot. process() hands them out (as event()) once the due
+    Processables have run, up to a budget per call. Interrupts post to
+    a queue of their own (post_from_isr()), the two take turns.
+*/
 class Processor {
 public:
     static Processor &get(); // Global Instance
     Processor();
 
+    /*
+        Every Processable is added to the global Processor when it's
+        made. Adding it to another one moves it over and it's due
+        straight away. That's ignored while the old one is in the
+        middle of a process() that's running it.
+    */
     void add_processable(Processable *);
 
+    // Pre-size the processable list when registering many at boot
+    void reserve(size_t count);
+
     void init();
+
+    // Run every Processable that's due, earliest deadline first
     void process();
 
+    // micros() of the next deadline (check has_work() first)
+    uint32_t next_wake() const;
+
+    // us until something's due (0 if something is, UINT32_MAX when
+    // everything is asleep)
+    uint32_t idle_for() const;
+
+    bool has_work() const {
+        return _heap.count() > 0 || !_events.empty() || !_isr_events.empty();
+    }
+
+    // Most posted events delivered per process(), the rest wait
+    void set_event_budget(uint16_t budget) { _event_budget = budget; }
+
+    // Inside a callback, the event being delivered (else nullptr)
+    const Event *current_event() const { return _current; }
+
+    size_t events_pending() const { return _events.count() + _isr_events.count(); }
+    uint32_t events_dropped() const { return _events.dropped() + _isr_events.dropped(); }
+
 private:
-    Vec<Processable *> _processables;
+    friend class Processable;
+    friend class host::ParallelProcessor;
+
+#ifdef LUTIL_STATIC_STORAGE
+    using ProcessList = StaticVec<Processable *, LUTIL_MAX_PROCESSABLES>;
+#else
+    using ProcessList = Vec<Processable *>;
+#endif
+
+    // Take item off our list and heap, false while it's running
+    bool _remove(Processable *item);
+
+    // Min-heap on (wake time, registration order)
+    void _schedule(Processable *item);
+    void _unschedule(Processable *item);
+    void _update(Processable *item);
+    void _sift_up(size_t index);
+    void _sift_down(size_t index);
+    void _place(size_t index, Processable *item);
+    static bool _before(const Processable *a, const Processable *b);
+
+    // process() in three steps, so other executors can run the middle
+    // one however they like
+    void _take_due(uint32_t now);
+    void _execute(size_t index, uint32_t now);
+    void _finish_due(uint32_t now);
+
+    // Hand out posted events, up to the budget
+    void _deliver();
+
+    ProcessList _processables;
+    ProcessList _heap;
+    ProcessList _due; // Popped off the heap this process()
+    uint16_t _order;
+
+    // post() from the loop (any thread on a host) and post_from_isr()
+    // from interrupts. Keeping them apart leaves one producer per
+    // queue on a uC, where an interrupt can land mid push.
+#ifdef BUILD_LIB
+    MpscQueue<Event, LUTIL_EVENT_QUEUE> _events;
+#else
+    SpscQueue<Event, LUTIL_EVENT_QUEUE> _events;
+#endif
+    SpscQueue<Event, LUTIL_ISR_EVENT_QUEUE> _isr_events;
+    uint16_t _event_budget;
+    const Event *_current;
+};
+
+/*
+    Per Processable counters, kept by the Processor
+*/
+struct ProcessStats {
+    uint32_t runs;
+    uint32_t total_us;    // Time in process()
+    uint32_t max_us;      // Longest single process()
+    uint32_t overruns;    // Started a whole period (or more) late
+    uint32_t max_late_us; // Worst start past the deadline
 };
 
 typedef void (*ProcessCallback)(void *);
+typedef Delegate<void()> ProcessDelegate;
+
+/*
+    Callbacks grouped by trigger in one contiguous array, plus where
+    each trigger's run starts. Calling a trigger is an indexed load and
+    an indirect call per callback, no searching.
+
+    Triggers are small non-negative ints (enum values) since they index
+    the table directly. With LUTIL_STATIC_STORAGE they have to be below
+    LUTIL_MAX_TRIGGERS.
+*/
+class CallbackTable {
+public:
+    // False when it's out of room (or the trigger is out of range)
+    bool add(int trigger, const ProcessDelegate &callback);
+
+    /*
+        A callback may add() to the table. Only the callbacks there
+        when the call started run, and an add() to a lower trigger
+        moves our run along, so the start is read again each time.
+    */
+    void call(int trigger) const {
+        size_t count = this->count(trigger);
+        for (size_t i = 0; i < count; i++) {
+            // A copy, the entry may move while it runs
+            ProcessDelegate callback = _entries[_starts[trigger] + i];
+            callback();
+        }
+    }
+
+    size_t count(int trigger) const;
+
+private:
+#ifdef LUTIL_STATIC_STORAGE
+    StaticVec<ProcessDelegate, LUTIL_MAX_TRIGGERS * LUTIL_MAX_CALLBACKS> _entries;
+    StaticVec<uint16_t, LUTIL_MAX_TRIGGERS + 1> _starts;
+#else
+    Vec<ProcessDelegate> _entries;
+    Vec<uint16_t> _starts;
+#endif
+};
 
 class Processable {
 public:
@@ -31,24 +191,84 @@ public:
     virtual void init() = 0;
     virtual void process() = 0;
 
+    // ----------------------------------------------------------------
+    // SCHEDULING (times are micros())
+
+    // Run every period us. 0 (the default) runs on every process().
+    void set_period(uint32_t period);
+    uint32_t period() const { return _period; }
+
+    /*
+        Run once the time passes when / after delay us. Periodic
+        Processables carry on with their period from there. Without a
+        period this puts the Processable in charge of its own schedule,
+        after each run it sleeps until it asks again.
+    */
+    void wake_at(uint32_t when);
+    void wake_in(uint32_t delay);
+
+    // Don't run again until woken
+    void sleep();
+
+    bool sleeping() const { return _slot == kIdle; }
+    uint32_t next_wake() const { return _wake; }
+
+    const ProcessStats &stats() const { return _stats; }
+    void reset_stats();
+
     void when(
         int trigger,
         ProcessCallback callback,
         void *data = nullptr
     );
 
+    // Lambdas, Delegates, (object, &Class::method) and the like
+    void when(int trigger, const ProcessDelegate &callback);
+
+    template<typename T>
+    void when(int trigger, T *object, void (T::*method)()) {
+        when(trigger, ProcessDelegate(object, method));
+    }
+
+    /*
+        Queue trigger for the Processor to deliver as event(trigger)
+        at the end of a process(). For the loop and, on host builds,
+        any thread. False when the queue is full. payload is there for
+        callbacks through Processor::current_event().
+    */
+    bool post(int trigger, uint32_t payload = 0);
+
+    // The same from an interrupt handler. One handler may be posting
+    // at a time, so not from interrupts that preempt each other.
+    bool post_from_isr(int trigger, uint32_t payload = 0);
+
 protected:
     // Called when an event occurs which will in turn fire any
     // registered callbacks
     void event(int trigger);
 
 private:
-    struct Callback
-    {
-        ProcessCallback callback;
-        void *data;
-    };
-    Map<int, Vec<Callback>> _callbacks;
+    friend class Processor;
+
+    // Where we are with respect to the Processor's heap
+    static const uint16_t kIdle = 0xFFFF;    // Not scheduled
+    static const uint16_t kRunning = 0xFFFE; // Due list, mid process()
+
+    // Processor calls these for each due item: run it (and count
+    // it), then once every due item has run, put it back on the heap
+    void _execute(uint32_t now);
+    void _reschedule(uint32_t now);
+
+    uint32_t _period;
+    uint32_t _wake;
+    uint16_t _slot;        // Heap index, kIdle or kRunning
+    uint16_t _order;       // Breaks ties between equal deadlines
+    bool _rescheduled;     // wake_at() called while due (kRunning)
+    bool _self_scheduled;  // No period, runs only when woken
+    Processor *_processor;
+    ProcessStats _stats;
+
+    CallbackTable _callbacks;
 };
 
 }
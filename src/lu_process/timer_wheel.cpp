@@ -0,0 +1,264 @@
+#include "timer_wheel.h"
+
+namespace lutil {
+
+// Bits of a set above position index
+static uint32_t bits_above(uint32_t bits, uint32_t index)
+{
+    return index >= 31 ? 0 : bits & ~((2UL << index) - 1);
+}
+
+static uint32_t lowest_bit(uint32_t bits)
+{
+    uint32_t index = 0;
+    while (!(bits & 1)) {
+        bits >>= 1;
+        index++;
+    }
+    return index;
+}
+
+Timer::Timer()
+    : _next(nullptr)
+    , _prev(nullptr)
+    , _wheel(nullptr)
+    , _target(nullptr)
+    , _trigger(0)
+    , _expires(0)
+    , _interval(0)
+    , _level(0)
+    , _slot(0)
+{
+}
+
+Timer::~Timer()
+{
+    if (_wheel)
+        _wheel->cancel(*this);
+}
+
+// --------------------------------------------------------------------
+
+TimerWheel &TimerWheel::get() {
+    static TimerWheel *instance = nullptr;
+    if (!instance) {
+        instance = new TimerWheel();
+    }
+    return *instance;
+}
+
+TimerWheel::TimerWheel()
+    : Processable()
+    , _due(nullptr)
+    , _now((uint32_t)millis())
+    , _count(0)
+{
+    for (uint8_t level = 0; level < kLevels; level++) {
+        _occupied[level] = 0;
+        for (uint32_t slot = 0; slot < kSlots; slot++)
+            _slots[level][slot] = nullptr;
+    }
+    sleep(); // Until there's a timer
+}
+
+void TimerWheel::start(
+    Timer &timer,
+    Processable *target,
+    int trigger,
+    uint32_t delay,
+    uint32_t interval)
+{
+    if (timer._wheel)
+        timer._wheel->cancel(timer);
+
+    uint32_t now = (uint32_t)millis();
+    if (!_count)
+        _now = now; // Nothing to catch up on
+
+    timer._wheel = this;
+    timer._target = target;
+    timer._trigger = trigger;
+    timer._expires = now + delay;
+    timer._interval = interval;
+    _insert(timer);
+    _count++;
+
+    _rearm();
+}
+
+void TimerWheel::cancel(Timer &timer)
+{
+    if (timer._wheel != this)
+        return;
+
+    _unlink(timer);
+    timer._wheel = nullptr;
+    _count--;
+}
+
+uint32_t TimerWheel::next_tick() const
+{
+    for (uint8_t level = 0; level < kLevels; level++) {
+        uint8_t shift = kBits * level;
+        uint32_t block = _now >> shift;
+        uint32_t index = block & kMask;
+
+        // A slot still ahead in this rotation
+        uint32_t later = bits_above(_occupied[level], index);
+        if (later)
+            return (block - index + lowest_bit(later)) << shift;
+
+        // Only slots for the next rotation, that starts with a cascade
+        if (_occupied[level])
+            return ((block | kMask) + 1) << shift;
+
+        // Nothing at this level, nothing happens before the next one
+    }
+    return _now + (1UL << (kBits * kLevels));
+}
+
+void TimerWheel::advance(uint32_t now)
+{
+    while ((int32_t)(now - _now) > 0) {
+        if (!_count) {
+            _now = now;
+            break;
+        }
+
+        // Skip straight to the next tick that does anything
+        uint32_t next = next_tick();
+        if ((int32_t)(now - next) < 0) {
+            _now = now;
+            break;
+        }
+        _now = next - 1;
+        _tick();
+    }
+}
+
+void TimerWheel::process()
+{
+    advance((uint32_t)millis());
+    _rearm();
+}
+
+Timer *&TimerWheel::_head(uint8_t level, uint8_t slot)
+{
+    return level == kDue ? _due : _slots[level][slot];
+}
+
+void TimerWheel::_insert(Timer &timer)
+{
+    const uint32_t span = 1UL << (kBits * kLevels);
+
+    // Anything overdue goes out on the next tick, anything beyond the
+    // top level waits at its far end and gets filed again from there
+    uint32_t ahead = (int32_t)(timer._expires - _now) > 0 ? timer._expires - _now : 1;
+    if (ahead >= span)
+        ahead = span - 1;
+    uint32_t key = _now + ahead;
+
+    uint8_t level = 0;
+    while (level + 1 < kLevels && ahead >= (1UL << (kBits * (level + 1))))
+        level++;
+    uint8_t slot = (key >> (kBits * level)) & kMask;
+
+    Timer *&head = _slots[level][slot];
+    timer._level = level;
+    timer._slot = slot;
+    timer._prev = nullptr;
+    timer._next = head;
+    if (head)
+        head->_prev = &timer;
+    head = &timer;
+    _occupied[level] |= 1UL << slot;
+}
+
+void TimerWheel::_unlink(Timer &timer)
+{
+    if (timer._prev) {
+        timer._prev->_next = timer._next;
+    }
+    else {
+        Timer *&head = _head(timer._level, timer._slot);
+        head = timer._next;
+        if (!head && timer._level != kDue)
+            _occupied[timer._level] &= ~(1UL << timer._slot);
+    }
+
+    if (timer._next)
+        timer._next->_prev = timer._prev;
+
+    timer._next = nullptr;
+    timer._prev = nullptr;
+}
+
+void TimerWheel::_move_due(uint8_t level, uint8_t slot)
+{
+    while (Timer *timer = _slots[level][slot]) {
+        _unlink(*timer);
+        timer->_level = kDue;
+        timer->_next = _due;
+        if (_due)
+            _due->_prev = timer;
+        _due = timer;
+    }
+}
+
+void TimerWheel::_tick()
+{
+    _now++;
+    uint8_t index = _now & kMask;
+
+    // A lap of the bottom ring brings the next slot up a level down
+    if (index == 0) {
+        for (uint8_t level = 1; level < kLevels; level++) {
+            uint8_t slot = (_now >> (kBits * level)) & kMask;
+            _move_due(level, slot);
+            if (slot != 0)
+                break;
+        }
+    }
+    _move_due(0, index);
+
+    while (_due) {
+        Timer &timer = *_due;
+        _unlink(timer);
+
+        if ((int32_t)(timer._expires - _now) > 0) {
+            _insert(timer); // Came down a level, not due yet
+            continue;
+        }
+
+        // Posted like any other event, the payload is the tick it was
+        // due. When the queue is full it goes again next tick.
+        if (timer._target && !timer._target->post(timer._trigger, timer._expires)) {
+            _insert(timer);
+            continue;
+        }
+
+        if (timer._interval) {
+            timer._expires += timer._interval;
+            if ((int32_t)(timer._expires - _now) <= 0)
+                timer._expires = _now + timer._interval; // Fell behind, skip
+            _insert(timer);
+        }
+        else {
+            timer._wheel = nullptr;
+            _count--;
+        }
+    }
+}
+
+void TimerWheel::_rearm()
+{
+    if (!_count) {
+        sleep();
+        return;
+    }
+
+    int32_t wait = (int32_t)(next_tick() - (uint32_t)millis());
+    wake_in(wait > 0 ? (uint32_t)wait * 1000 : 0);
+}
+
+}
@@ -0,0 +1,144 @@
+/*
+    Shared millisecond timers, posted as Processable events.
+
+    A hierarchical timer wheel: each level is a ring of slots, one tick
+    (1 ms) a slot at the bottom and a whole lower ring a slot above
+    that. Starting or cancelling a timer is O(1), and the wheel only
+    wakes (see Processor) for ticks that have something in them, so
+    hundreds of idle timers cost nothing between expiries.
+
+    .. code-block:: cpp
+
+        class Heater : public lutil::Processable {
+        public:
+            enum Trigger { Check = 1 };
+
+            void init() override {
+                when(Check, on_check, this);
+                lutil::TimerWheel::get().start(_check, this, Check, 500, 500);
+            }
+            void process() override {}
+
+        private:
+            static void on_check(void *self) { ... }
+            lutil::Timer _check; // Intrusive, no allocation
+        };
+
+    Deadlines are compared wrap safe, so timers keep working across the
+    millis() rollover. Delays longer than the wheel spans (~17 minutes
+    with the defaults) are fine, they just get re-filed on the way.
+*/
+#pragma once
+#include "lutil.h"
+#include "process.h"
+
+// 2^BITS slots a level (at most 5, the occupancy maps are 32 bit)
+#ifndef LUTIL_TIMER_WHEEL_BITS
+#define LUTIL_TIMER_WHEEL_BITS 5
+#endif
+
+#ifndef LUTIL_TIMER_WHEEL_LEVELS
+#define LUTIL_TIMER_WHEEL_LEVELS 4
+#endif
+
+namespace lutil {
+
+class TimerWheel;
+
+/*
+    One timer. Lives wherever its owner does, the wheel only links it
+    in. Going out of scope cancels it.
+*/
+class Timer {
+public:
+    Timer();
+    ~Timer();
+
+    Timer(const Timer &) = delete;
+    Timer &operator=(const Timer &) = delete;
+
+    bool active() const { return _wheel != nullptr; }
+    uint32_t expires() const { return _expires; } // millis()
+    uint32_t interval() const { return _interval; }
+
+private:
+    friend class TimerWheel;
+
+    Timer *_next;
+    Timer *_prev;
+    TimerWheel *_wheel;   // While active
+    Processable *_target;
+    int _trigger;
+    uint32_t _expires;
+    uint32_t _interval;   // 0 for one shot
+    uint8_t _level;       // Which list we're in
+    uint8_t _slot;
+};
+
+class TimerWheel : public Processable {
+public:
+    static TimerWheel &get(); // Global Instance
+    TimerWheel();
+
+    /*
+        target->post(trigger) after delay ms, then every interval ms
+        when that's not 0 (a delay of 0 goes out on the next tick).
+        The payload is the millis() it was due. Restarts the timer if
+        it's already running. An event already posted still arrives
+        after a cancel() or restart.
+
+        When the Processor's event queue is full the timer is held
+        back a tick rather than lost (the refused post still shows in
+        Processor::events_dropped()).
+    */
+    void start(
+        Timer &timer,
+        Processable *target,
+        int trigger,
+        uint32_t delay,
+        uint32_t interval = 0
+    );
+
+    void cancel(Timer &timer);
+
+    // Timers running
+    size_t count() const { return _count; }
+
+    // Tick (millis()) the wheel has been advanced to
+    uint32_t now() const { return _now; }
+
+    // Earliest tick anything could expire or move down a level. Only
+    // meaningful while count() > 0.
+    uint32_t next_tick() const;
+
+    // Expire everything due by now (millis()). process() does this.
+    void advance(uint32_t now);
+
+    void init() override {}
+    void process() override;
+
+private:
+    static const uint8_t kBits = LUTIL_TIMER_WHEEL_BITS;
+    static const uint8_t kLevels = LUTIL_TIMER_WHEEL_LEVELS;
+    static const uint32_t kSlots = 1UL << kBits;
+    static const uint32_t kMask = kSlots - 1;
+    static const uint8_t kDue = 0xFF; // _level of the expiring list
+
+    static_assert(kBits >= 1 && kBits <= 5, "LUTIL_TIMER_WHEEL_BITS is 1 to 5");
+    static_assert(kBits * kLevels < 32, "Timer wheel spans more than 32 bits");
+
+    Timer *&_head(uint8_t level, uint8_t slot);
+    void _insert(Timer &timer);
+    void _unlink(Timer &timer);
+    void _move_due(uint8_t level, uint8_t slot);
+    void _tick();
+    void _rearm();
+
+    Timer *_slots[kLevels][kSlots];
+    uint32_t _occupied[kLevels]; // Bit per non empty slot
+    Timer *_due;
+    uint32_t _now;
+    size_t _count;
+};
+
+}
@@ -4,14 +4,20 @@
 #pragma once
 #include "lutil.h"
 #include "lu_storage/map.h"
+#include "lu_storage/hash_map.h"
+#include "lu_storage/interner.h"
 #include "lu_output/printer.h"
 #include "lu_process/process.h"
 #include "lu_memory/managed_ptr.h"
 
 #include "lu_state/state_macros.h"
 
+/*
+    Declare a state name. The hash is worked out at compile time so
+    registering it with the interner is a single probe.
+*/
 #define STATE(name) \
-    constexpr char name[] = #name;
+    constexpr lutil::StaticName name(#name, sizeof(#name) - 1);
 
 namespace lutil {
 
@@ -47,7 +53,7 @@ class StateDriver : public _AbstractDriver {
 public:
     typedef bool (Derived::*TransitionPredicate)();
     typedef void (Derived::*RuntimeFunction)();
-    using PredicateMap = Map<uint16_t, TransitionPredicate>;
+    using PredicateMap = Map<Atom, TransitionPredicate>;
 
     StateDriver() {
         _current_state = _initial_state();
@@ -55,23 +61,16 @@ public:
     }
 
     managed_string current_state() const {
-        // Printer::print("_GCS_ %", _known_states.count())
-        // delay(100);
-
-        auto s = _known_states.key_from_value(_current_state);
-
-        // Printer::print("__st: %", s.c_str());
-        // delay(100);
-
-        return s;
+        return StringInterner::global().name(_current_state);
     }
 
-    uint16_t current_state_id() const {
+    // The interned atom of the current state
+    Atom current_state_id() const {
         return _current_state;
     }
 
-    bool add_runtime(managed_string state, RuntimeFunction func) {
-        uint16_t state_id = _state_id(state);
+    bool add_runtime(AtomKey state, RuntimeFunction func) {
+        Atom state_id = _state_id(state);
         if (!_runtimes.contains(state_id)) {
             _runtimes[state_id] = {};
         }
@@ -80,12 +79,12 @@ public:
     }
 
     bool add_transition(
-        managed_string from_state,
-        managed_string to_state,
+        AtomKey from_state,
+        AtomKey to_state,
         TransitionPredicate predicate)
     {
-        uint16_t from_id = _state_id(from_state);
-        uint16_t to_id = _state_id(to_state);
+        Atom from_id = _state_id(from_state);
+        Atom to_id = _state_id(to_state);
 
         if (!_predicates.contains(from_id)) {
             _predicates[from_id] = PredicateMap();
@@ -116,7 +115,7 @@ public:
 
             Vec<RuntimeFunction> &runtimes = _runtimes[_current_state];
             auto it = runtimes.begin();
-            uint16_t original_state = _current_state;
+            Atom original_state = _current_state;
 
             for (; it != runtimes.end(); it++) {
                 Derived *self = static_cast<Derived *>(this);
@@ -164,56 +163,58 @@ protected:
         transitions - that way we can move more logic out
     */
     virtual void _register_machine() {}
-    void _register_runtime(managed_string name, RuntimeFunction func) {
-        _reg_runtime[name].push(func);
+    void _register_runtime(AtomKey name, RuntimeFunction func) {
+        _reg_runtime[name.intern()].push(func);
     }
-    void _register_transition(managed_string name, TransitionPredicate predicate) {
-        _reg_transitions[name].push(predicate);
+    void _register_transition(AtomKey name, TransitionPredicate predicate) {
+        _reg_transitions[name.intern()].push(predicate);
     }
 
     // -- Force a partiuclar state
-    bool set_current_state(managed_string name) {
+    bool set_current_state(AtomKey name) {
         _current_state = _state_id(name);
         return true;
     }
 
 private:
-    uint16_t _state_id(managed_string state) {
-        if (!_known_states.contains(state)) {
-            uint16_t id = _known_states.count();
-            _known_states.insert(state, id);
-        }
+    Atom _state_id(const AtomKey &state) {
+        Atom output = state.intern();
 
-        uint16_t output = _known_states[state];
+        // The first state we hear about is where we start
+        if (_current_state == kNoAtom)
+            _current_state = output;
         return output;
     }
 
     /*
-        We have to make sure that initial state has an id
+        Nothing is known yet, the first state registered takes over
     */
-    uint16_t _initial_state() {
+    Atom _initial_state() {
         // managed_string st = initial_state();
-        return 0;
+        return kNoAtom;
     }
 
-    uint16_t _current_state;
+    Atom _current_state;
 
     /*
         We have three mappings
 
-        - each known state recieves a unique ID at runtime.
+        - each known state is an atom from the global interner.
         - Each state can contain transition predicates that will
           automatically switch to another state upon some requirement
           being true
         - Each state can contain a number of runtime proceedures
+
+        Names are only turned into atoms while building the machine,
+        after that everything compares integers. The latter two are
+        looked up every tick so they're hashed.
     */
-    Map<managed_string, uint16_t> _known_states;
-    Map<uint16_t, PredicateMap> _predicates;
-    Map<uint16_t, Vec<RuntimeFunction>> _runtimes;
+    HashMap<Atom, PredicateMap> _predicates;
+    HashMap<Atom, Vec<RuntimeFunction>> _runtimes;
 
 
-    Map<managed_string, Vec<TransitionPredicate>> _reg_transitions;
-    Map<managed_string, Vec<RuntimeFunction>> _reg_runtime;
+    Map<Atom, Vec<TransitionPredicate>> _reg_transitions;
+    Map<Atom, Vec<RuntimeFunction>> _reg_runtime;
 };
 
 }
@@ -0,0 +1,297 @@
+#pragma once
+#include "lutil.h"
+#include "lu_memory/utility.h"
+#include "lu_storage/vector.h"
+
+namespace lutil {
+
+/*
+    Sorted, contiguous map for read-mostly tables. Keys are kept in
+    order in their own array so lookups are a binary search over
+    tightly packed keys - O(log n) rather than Map's linear scan.
+
+    Inserting is O(n) (we shift to keep the order) so fill it once,
+    ideally with build_from(), and query it from then on.
+
+    - KEY needs operator< (and operator== for key_from_value users)
+    - VALUE needs a default constructor
+    - Iteration is in key order with the usual key()/value() API
+*/
+template<typename KEY, typename VALUE>
+class FlatMap {
+public:
+    FlatMap() {}
+
+    explicit FlatMap(size_t size) {
+        reserve(size);
+    }
+
+    VALUE &operator[](const KEY &key) {
+        size_t idx = _lower_bound(key);
+        if (!_match(idx, key))
+            _insert_at(idx, key, VALUE());
+        return _values[idx];
+    }
+
+    size_t count() const { return _keys.count(); }
+
+    void reserve(size_t size) {
+        _keys.reserve(size);
+        _values.reserve(size);
+    }
+
+    void insert(const KEY &key, const VALUE &value) {
+        size_t idx = _lower_bound(key);
+        if (_match(idx, key)) {
+            _values[idx] = value;
+            return;
+        }
+        _insert_at(idx, key, value);
+    }
+
+    bool contains(const KEY &key) const {
+        return _match(_lower_bound(key), key);
+    }
+
+    // nullptr when we don't have it
+    VALUE *find(const KEY &key) {
+        size_t idx = _lower_bound(key);
+        return _match(idx, key) ? &_values[idx] : nullptr;
+    }
+
+    void remove(const KEY &key) {
+        size_t idx = _lower_bound(key);
+        if (!_match(idx, key))
+            return; // Don't have it
+
+        _keys.pop((int)idx);
+        _values.pop((int)idx);
+    }
+
+    KEY key_from_value(const VALUE &val) const {
+        for (size_t i = 0; i < count(); i++) {
+            if (_values[i] == val) {
+                return _keys[i];
+            }
+        }
+        return KEY();
+    }
+
+    /*
+        Replace the contents with count key/value pairs, sorting once
+        rather than shifting on every insert. When a key shows up more
+        than once the last value wins (like repeated insert() calls).
+    */
+    void build_from(const KEY *keys, const VALUE *values, size_t count) {
+        Vec<size_t> order(count);
+        for (size_t i = 0; i < count; i++)
+            order[i] = i;
+
+        // Shell sort the permutation. Ties go by input position so
+        // the sort is stable.
+        for (size_t gap = count / 2; gap > 0; gap /= 2) {
+            for (size_t i = gap; i < count; i++) {
+                size_t item = order[i];
+                size_t j = i;
+                for (; j >= gap && _before(keys, item, order[j - gap]); j -= gap)
+                    order[j] = order[j - gap];
+                order[j] = item;
+            }
+        }
+
+        _keys = Vec<KEY>(0);
+        _values = Vec<VALUE>(0);
+        reserve(count);
+
+        for (size_t i = 0; i < count; i++) {
+            const KEY &key = keys[order[i]];
+            size_t last = _keys.count();
+            if (last > 0 && !(_keys[last - 1] < key)) {
+                _values[last - 1] = values[order[i]];
+                continue;
+            }
+            _keys.push(key);
+            _values.push(values[order[i]]);
+        }
+    }
+
+    /* Build from anything with our Iterator interface (Map, HashMap) */
+    template<typename MAP>
+    void build_from(MAP &map) {
+        Vec<KEY> keys(0);
+        Vec<VALUE> values(0);
+        keys.reserve(map.count());
+        values.reserve(map.count());
+
+        for (auto it = map.begin(); it != map.end(); it++) {
+            keys.push(it.key());
+            values.push(it.value());
+        }
+        build_from(keys.count() ? &keys[0] : nullptr,
+                   values.count() ? &values[0] : nullptr,
+                   keys.count());
+    }
+
+
+    // ----------------------------------------------------------------
+    // ITERATION
+
+    class Iterator {
+    public:
+        Iterator(FlatMap *map, int index = 0)
+            : _map(map)
+            , _index(index)
+        {}
+
+        Iterator(const Iterator &it)
+            : _map(it._map)
+            , _index(it._index)
+        {}
+
+        KEY &key() {
+            return _map->_keys[_index];
+        }
+
+        VALUE &value() {
+            return _map->_values[_index];
+        }
+
+        Iterator &operator++ () {
+            _index++;
+            return *this;
+        }
+
+        Iterator operator++ (int) {
+            Iterator output(*this);
+            ++(*this);
+            return output;
+        }
+
+        bool has_next() const {
+            return _index < _map->count();
+        }
+
+        bool operator== (const Iterator &other) const {
+            return (this->_map == other._map &&
+                    this->_index == other._index);
+        }
+
+        bool operator!= (const Iterator &other) const {
+            return (this->_map != other._map ||
+                    this->_index != other._index);
+        }
+
+    private:
+        FlatMap *_map;
+        size_t _index;
+    };
+
+    Iterator begin() {
+        return Iterator(this);
+    }
+
+    Iterator end() {
+        return Iterator(this, (int)count());
+    }
+
+private:
+    static bool _before(const KEY *keys, size_t a, size_t b) {
+        if (keys[a] < keys[b])
+            return true;
+        if (keys[b] < keys[a])
+            return false;
+        return a < b;
+    }
+
+    // First index whose key is not less than key
+    size_t _lower_bound(const KEY &key) const {
+        size_t low = 0;
+        size_t high = _keys.count();
+        while (low < high) {
+            size_t mid = low + (high - low) / 2;
+            if (_keys[mid] < key)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        return low;
+    }
+
+    bool _match(size_t idx, const KEY &key) const {
+        return idx < _keys.count() && !(key < _keys[idx]);
+    }
+
+    void _insert_at(size_t idx, const KEY &key, const VALUE &value) {
+        // key/value may point into our own storage
+        KEY k(key);
+        VALUE v(value);
+
+        _keys.push(KEY());
+        _values.push(VALUE());
+        for (size_t i = _keys.count() - 1; i > idx; i--) {
+            _keys[i] = lutil::move(_keys[i - 1]);
+            _values[i] = lutil::move(_values[i - 1]);
+        }
+        _keys[idx] = lutil::move(k);
+        _values[idx] = lutil::move(v);
+    }
+
+    Vec<KEY> _keys;
+    Vec<VALUE> _values;
+};
+
+
+/*
+    Read-only view over pre-sorted key/value arrays. Nothing is copied
+    so the tables can be ``const`` data that the toolchain leaves in
+    flash.
+
+    .. code-block:: cpp
+
+        static const uint16_t kIds[] = { 1, 4, 9 };
+        static const char *const kNames[] = { "one", "four", "nine" };
+        lutil::FrozenFlatMap<uint16_t, const char *> names(kIds, kNames, 3);
+
+        const char *const *n = names.find(4);
+*/
+template<typename KEY, typename VALUE>
+class FrozenFlatMap {
+public:
+    constexpr FrozenFlatMap(const KEY *keys, const VALUE *values, size_t count)
+        : _keys(keys)
+        , _values(values)
+        , _count(count)
+    {}
+
+    size_t count() const { return _count; }
+
+    bool contains(const KEY &key) const {
+        return find(key) != nullptr;
+    }
+
+    // nullptr when we don't have it
+    const VALUE *find(const KEY &key) const {
+        size_t low = 0;
+        size_t high = _count;
+        while (low < high) {
+            size_t mid = low + (high - low) / 2;
+            if (_keys[mid] < key)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        if (low < _count && !(key < _keys[low]))
+            return &_values[low];
+        return nullptr;
+    }
+
+    const KEY &key(size_t index) const { return _keys[index]; }
+    const VALUE &value(size_t index) const { return _values[index]; }
+
+private:
+    const KEY *_keys;
+    const VALUE *_values;
+    size_t _count;
+};
+
+}
@@ -0,0 +1,61 @@
+/*
+    Capacity policy shared by the growable storage types.
+*/
+#pragma once
+#include "lutil.h"
+
+namespace lutil {
+
+enum class Growth : uint8_t {
+    Geometric, // Grow by ``amount`` percent of the current size
+    Step,      // Grow by ``amount`` elements
+    Fixed,     // Never reallocate - adds fail once we're full
+};
+
+/*
+    How a container picks its next capacity once it runs out of room.
+
+    .. code-block:: cpp
+
+        vec.set_growth(lutil::GrowthPolicy::geometric(50)); // 1.5x
+        vec.set_growth(lutil::GrowthPolicy::step(32));      // +32
+        vec.set_growth(lutil::GrowthPolicy::fixed());       // no realloc
+*/
+struct GrowthPolicy {
+    Growth mode;
+    uint16_t amount;
+
+    static GrowthPolicy geometric(uint16_t percent = 100) {
+        return { Growth::Geometric, percent };
+    }
+
+    static GrowthPolicy step(uint16_t elements) {
+        return { Growth::Step, elements };
+    }
+
+    static GrowthPolicy fixed() {
+        return { Growth::Fixed, 0 };
+    }
+
+    /*
+        The capacity to move to from size when we need room for at
+        least needed elements. Returns 0 when we're not allowed to
+        grow.
+    */
+    size_t next(size_t size, size_t needed) const {
+        size_t output = size;
+        switch (mode) {
+        case Growth::Geometric:
+            output = size + (size * amount) / 100;
+            break;
+        case Growth::Step:
+            output = size + amount;
+            break;
+        case Growth::Fixed:
+            return 0;
+        }
+        return (output < needed) ? needed : output;
+    }
+};
+
+}
@@ -0,0 +1,123 @@
+/*
+    Hash traits used by the hashed storage types (HashMap).
+
+    Specialize Hash<T> for your own key types:
+
+    .. code-block:: cpp
+
+        template<>
+        struct lutil::Hash<MyKey> {
+            static uint32_t hash(const MyKey &key) { return key.id; }
+        };
+
+    (managed_string brings its own, see managed_ptr.h)
+
+    HashMap compares keys with KeyEqual<T>, which is == unless
+    specialized. The two have to agree: keys that compare equal must
+    hash alike.
+*/
+#pragma once
+#include <string.h>
+#include "lutil.h"
+
+namespace lutil {
+
+/*
+    Murmur3 finalizer. Integer keys tend to be small and sequential
+    (trigger ids, state ids) so we have to spread them over the
+    whole word before masking off the low bits.
+*/
+inline uint32_t hash_mix(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85EBCA6BUL;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35UL;
+    h ^= h >> 16;
+    return h;
+}
+
+/* 32 bit FNV-1a over a null terminated string */
+inline uint32_t hash_string(const char *data) {
+    uint32_t h = 0x811C9DC5UL;
+    if (!data)
+        return h;
+    for (; *data != '\0'; data++) {
+        h ^= (uint8_t)*data;
+        h *= 0x01000193UL;
+    }
+    return h;
+}
+
+/*
+    Same hash as hash_string() but usable in constant expressions so
+    names known at compile time are hashed by the compiler (see
+    StaticName). Written as a recursion to stay C++11 constexpr.
+*/
+constexpr uint32_t hash_literal(const char *data, uint32_t h = 0x811C9DC5UL) {
+    return (*data == '\0')
+        ? h
+        : hash_literal(data + 1, (uint32_t)((h ^ (uint8_t)*data) * 0x01000193UL));
+}
+
+template<typename T>
+struct Hash;
+
+#define _LUTIL_INTEGER_HASH(type)                      \
+    template<>                                         \
+    struct Hash<type> {                                \
+        static uint32_t hash(type key) {               \
+            return hash_mix((uint32_t)key);            \
+        }                                              \
+    };
+
+_LUTIL_INTEGER_HASH(char)
+_LUTIL_INTEGER_HASH(signed char)
+_LUTIL_INTEGER_HASH(unsigned char)
+_LUTIL_INTEGER_HASH(short)
+_LUTIL_INTEGER_HASH(unsigned short)
+_LUTIL_INTEGER_HASH(int)
+_LUTIL_INTEGER_HASH(unsigned int)
+
+#undef _LUTIL_INTEGER_HASH
+
+#define _LUTIL_WIDE_INTEGER_HASH(type)                            \
+    template<>                                                    \
+    struct Hash<type> {                                           \
+        static uint32_t hash(type key) {                          \
+            uint64_t k = (uint64_t)key;                           \
+            return hash_mix((uint32_t)k ^ (uint32_t)(k >> 32));   \
+        }                                                         \
+    };
+
+_LUTIL_WIDE_INTEGER_HASH(long)
+_LUTIL_WIDE_INTEGER_HASH(unsigned long)
+_LUTIL_WIDE_INTEGER_HASH(long long)
+_LUTIL_WIDE_INTEGER_HASH(unsigned long long)
+
+#undef _LUTIL_WIDE_INTEGER_HASH
+
+template<typename T>
+struct KeyEqual {
+    static bool equal(const T &a, const T &b) { return a == b; }
+};
+
+/*
+    C strings are keyed by their content, so the same text at two
+    addresses is one key. The map stores the pointer, not a copy, so
+    the text has to outlive its entry.
+*/
+template<>
+struct Hash<const char *> {
+    static uint32_t hash(const char *key) {
+        return hash_string(key);
+    }
+};
+
+template<>
+struct KeyEqual<const char *> {
+    static bool equal(const char *a, const char *b) {
+        return a == b || (a && b && strcmp(a, b) == 0);
+    }
+};
+
+}
@@ -0,0 +1,397 @@
+#pragma once
+#include "lutil.h"
+#include "lu_memory/utility.h"
+#include "lu_storage/hash.h"
+
+#define LUTIL_HASH_DEFAULT_SIZE 8
+
+namespace lutil {
+
+/*
+    Slot storage for the HashMap. With N == 0 the slots live on the
+    heap and grow with the map. Otherwise we hold exactly N slots
+    inline and never touch the heap.
+*/
+template<typename KEY, typename VALUE, size_t N>
+struct _HashSlots {
+    KEY keys[N];
+    VALUE values[N];
+    bool used[N];
+
+    // Handed out by operator[] when a fixed map is full
+    VALUE overflow;
+};
+
+template<typename KEY, typename VALUE>
+struct _HashSlots<KEY, VALUE, 0> {};
+
+
+/*
+    Open addressing (linear probing) hash map. Drop-in for Map where
+    lookups dominate - same Iterator key()/value() interface, but
+    operator[], contains(), insert() and remove() are O(1) on average.
+
+    - KEY and VALUE need a default constructor
+    - HASH is a trait with a static ``uint32_t hash(const KEY &)``
+      (see lu_storage/hash.h). Keys are compared with KeyEqual<KEY>.
+    - N > 0 gives a fixed-capacity map with inline storage (no heap).
+      N must be a power of two.
+
+    Iteration order is the slot order, *not* the insertion order.
+
+    .. code-block:: cpp
+
+        lutil::HashMap<int, float> heap_map;
+        lutil::HashMap<int, float, lutil::Hash<int>, 16> fixed_map;
+*/
+template<typename KEY, typename VALUE, typename HASH = Hash<KEY>, size_t N = 0>
+class HashMap {
+public:
+    static_assert((N & (N - 1)) == 0, "HashMap capacity must be a power of two");
+
+    HashMap() {
+        _init(LUTIL_HASH_DEFAULT_SIZE);
+    }
+
+    // Reserve room for (at least) size entries up front
+    explicit HashMap(size_t size) {
+        size_t capacity = LUTIL_HASH_DEFAULT_SIZE;
+        while (capacity * 3 < size * 4)
+            capacity <<= 1;
+        _init(capacity);
+    }
+
+    ~HashMap() {
+        _release();
+    }
+
+    HashMap(const HashMap &other) {
+        _init(other._capacity);
+        _from_other(other);
+    }
+
+    HashMap &operator= (const HashMap &other) {
+        if (this == &other)
+            return *this;
+
+        if (N == 0 && _capacity != other._capacity) {
+            _release();
+            _init(other._capacity);
+        }
+        else {
+            clear();
+        }
+        _from_other(other);
+        return *this;
+    }
+
+    /*
+        A miss inserts a default VALUE. A full fixed map can't, and
+        hands back a scratch value of its own instead: it's reset on
+        every such miss and never stored. Use insert() when a fixed
+        map may fill up, it says so.
+    */
+    VALUE &operator[](const KEY &key) {
+        int idx = _index_of(key);
+        if (idx >= 0)
+            return _values[idx];
+
+        idx = _claim(key);
+        if (idx < 0)
+            return _overflow(); // Full fixed map
+        return _values[idx];
+    }
+
+    size_t count() const { return _count; }
+    size_t capacity() const { return _capacity; }
+
+    /*
+        Insert or replace a value. Returns false only when a fixed
+        capacity map has no room left (where operator[] would quietly
+        hand back scratch).
+    */
+    bool insert(const KEY &key, const VALUE &value) {
+        int idx = _index_of(key);
+        if (idx < 0) {
+            idx = _claim(key);
+            if (idx < 0)
+                return false;
+        }
+        _values[idx] = value;
+        return true;
+    }
+
+    bool contains(const KEY &key) const {
+        return (_index_of(key) >= 0);
+    }
+
+    void remove(const KEY &key) {
+        int index = _index_of(key);
+        if (index < 0)
+            return; // Don't have it
+
+        _remove((size_t)index);
+    }
+
+    void clear() {
+        for (size_t i = 0; i < _capacity; i++) {
+            if (_used[i]) {
+                _keys[i] = KEY();
+                _values[i] = VALUE();
+                _used[i] = false;
+            }
+        }
+        _count = 0;
+    }
+
+    KEY key_from_value(const VALUE &val) const {
+        for (size_t i = 0; i < _capacity; i++) {
+            if (_used[i] && _values[i] == val) {
+                return _keys[i];
+            }
+        }
+        return KEY();
+    }
+
+
+    // ----------------------------------------------------------------
+    // ITERATION
+
+    class Iterator {
+    public:
+        Iterator(HashMap *map, int index = 0)
+            : _map(map)
+            , _index(index)
+        {
+            _skip();
+        }
+
+        Iterator(const Iterator &it)
+            : _map(it._map)
+            , _index(it._index)
+        {}
+
+        KEY &key() {
+            return _map->_keys[_index];
+        }
+
+        VALUE &value() {
+            return _map->_values[_index];
+        }
+
+        Iterator &operator++ () {
+            _index++;
+            _skip();
+            return *this;
+        }
+
+        Iterator operator++ (int) {
+            Iterator output(*this);
+            ++(*this);
+            return output;
+        }
+
+        bool has_next() const {
+            return _index < _map->_capacity;
+        }
+
+        bool operator== (const Iterator &other) const {
+            return (this->_map == other._map &&
+                    this->_index == other._index);
+        }
+
+        bool operator!= (const Iterator &other) const {
+            return (this->_map != other._map ||
+                    this->_index != other._index);
+        }
+
+    private:
+        // Move onto the next occupied slot (or the end)
+        void _skip() {
+            while (_index < _map->_capacity && !_map->_used[_index])
+                _index++;
+        }
+
+        HashMap *_map;
+        size_t _index;
+    };
+
+    Iterator begin() {
+        return Iterator(this);
+    }
+
+    Iterator end() {
+        return Iterator(this, (int)_capacity);
+    }
+
+
+private:
+    void _init(size_t capacity) {
+        _count = 0;
+        _capacity = N ? N : capacity;
+        _bind(bool_tag<(N > 0)>());
+    }
+
+    void _bind(bool_tag<true>) {
+        _keys = _slots.keys;
+        _values = _slots.values;
+        _used = _slots.used;
+        for (size_t i = 0; i < _capacity; i++)
+            _used[i] = false;
+    }
+
+    void _bind(bool_tag<false>) {
+        _keys = new KEY[_capacity];
+        _values = new VALUE[_capacity];
+        _used = new bool[_capacity];
+        memset(_used, 0, _capacity * sizeof(bool));
+    }
+
+    void _release() {
+        if (N == 0) {
+            delete [] _keys;
+            delete [] _values;
+            delete [] _used;
+        }
+    }
+
+    VALUE &_overflow() {
+        return _overflow(bool_tag<(N > 0)>());
+    }
+
+    VALUE &_overflow(bool_tag<true>) {
+        _slots.overflow = VALUE();
+        return _slots.overflow;
+    }
+
+    VALUE &_overflow(bool_tag<false>) {
+        return _values[0]; // Unreachable, heap maps always grow
+    }
+
+    size_t _home(const KEY &key) const {
+        return HASH::hash(key) & (_capacity - 1);
+    }
+
+    int _index_of(const KEY &key) const {
+        size_t mask = _capacity - 1;
+        size_t i = _home(key);
+        for (size_t probe = 0; probe < _capacity; probe++) {
+            if (!_used[i])
+                return -1;
+            if (KeyEqual<KEY>::equal(_keys[i], key))
+                return (int)i;
+            i = (i + 1) & mask;
+        }
+        return -1;
+    }
+
+    /*
+        Take an empty slot for a key we know we don't have yet.
+        Returns -1 if a fixed map is out of room.
+    */
+    int _claim(const KEY &key) {
+        if (N == 0) {
+            // Keep the load factor under 3/4 so probes stay short
+            if ((_count + 1) * 4 > _capacity * 3)
+                _rehash(_capacity * 2);
+        }
+        else if (_count == _capacity) {
+            return -1;
+        }
+
+        size_t mask = _capacity - 1;
+        size_t i = _home(key);
+        while (_used[i])
+            i = (i + 1) & mask;
+
+        _used[i] = true;
+        _keys[i] = key;
+        _count++;
+        return (int)i;
+    }
+
+    void _rehash(size_t capacity) {
+        KEY *old_keys = _keys;
+        VALUE *old_values = _values;
+        bool *old_used = _used;
+        size_t old_capacity = _capacity;
+
+        _capacity = capacity;
+        _bind(bool_tag<false>());
+
+        size_t mask = _capacity - 1;
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (!old_used[i])
+                continue;
+
+            size_t j = _home(old_keys[i]);
+            while (_used[j])
+                j = (j + 1) & mask;
+
+            _used[j] = true;
+            _keys[j] = move(old_keys[i]);
+            _values[j] = move(old_values[i]);
+        }
+
+        delete [] old_keys;
+        delete [] old_values;
+        delete [] old_used;
+    }
+
+    /*
+        Backward shift deletion. Rather than leaving a tombstone we
+        pull any displaced followers back so lookups never have to
+        skip over dead slots.
+    */
+    void _remove(size_t index) {
+        size_t mask = _capacity - 1;
+        size_t hole = index;
+        size_t i = index;
+
+        _used[hole] = false;
+        while (true) {
+            i = (i + 1) & mask;
+            if (!_used[i])
+                break; // Also stops us on a full, fixed table
+
+            // How far each slot sits from its home position. If the
+            // follower is further from home than the hole, it can
+            // fill it.
+            size_t home = _home(_keys[i]);
+            if (((i - home) & mask) >= ((i - hole) & mask)) {
+                _keys[hole] = move(_keys[i]);
+                _values[hole] = move(_values[i]);
+                _used[hole] = true;
+                _used[i] = false;
+                hole = i;
+            }
+        }
+
+        _keys[hole] = KEY();
+        _values[hole] = VALUE();
+        _count--;
+    }
+
+    void _from_other(const HashMap &other) {
+        // Same capacity so the slot layout is identical
+        for (size_t i = 0; i < _capacity; i++) {
+            _used[i] = other._used[i];
+            if (_used[i]) {
+                _keys[i] = other._keys[i];
+                _values[i] = other._values[i];
+            }
+        }
+        _count = other._count;
+    }
+
+    size_t _capacity;
+    size_t _count;
+
+    KEY *_keys;
+    VALUE *_values;
+    bool *_used;
+
+    _HashSlots<KEY, VALUE, N> _slots;
+};
+
+}
@@ -0,0 +1,228 @@
+/*
+    String interning. Every distinct string gets a small, stable
+    integer (an Atom) so hot paths compare integers instead of
+    characters.
+
+    .. code-block:: cpp
+
+        lutil::StringInterner &names = lutil::StringInterner::global();
+
+        lutil::Atom off = names.intern("Off");
+        names.intern("Off") == off; // true, same string same atom
+        names.name(off);            // "Off"
+
+    Strings known at compile time can carry their hash with them
+    (see StaticName and STATE() in lu_state/state.h) so interning
+    them never walks the characters to hash them.
+*/
+#pragma once
+#include "lutil.h"
+#include "lu_memory/managed_ptr.h"
+#include "lu_storage/hash.h"
+#include "lu_storage/vector.h"
+
+namespace lutil {
+
+typedef uint16_t Atom;
+
+// Returned by find() for strings we've never seen
+constexpr Atom kNoAtom = 0xFFFF;
+
+
+/*
+    A string literal with its length and hash worked out by the
+    compiler. Converts to a plain ``const char *`` so it can be used
+    anywhere the literal could.
+*/
+struct StaticName {
+    constexpr StaticName(const char *text, size_t length)
+        : name(text)
+        , size(length)
+        , hash(hash_literal(text))
+    {}
+
+    constexpr operator const char *() const { return name; }
+
+    const char *name;
+    size_t size;
+    uint32_t hash;
+};
+
+#define LU_STATIC_NAME(text) lutil::StaticName(text, sizeof(text) - 1)
+
+
+/*
+    Open addressing table of atoms (indices into the name list).
+    Lookups are O(1) and probe on the cached hash first so the
+    characters are only compared on a real match.
+
+    Atoms are never released, this is meant for the finite set of
+    names a program uses (states, ini keys, ...).
+*/
+class StringInterner {
+public:
+    StringInterner()
+        : _names(0)
+        , _hashes(0)
+        , _slots(16)
+    {
+        _clear_slots();
+    }
+
+    // One table for the whole program
+    static StringInterner &global() {
+        static StringInterner s_interner;
+        return s_interner;
+    }
+
+    Atom intern(const char *text) {
+        if (!text)
+            text = "";
+        return _intern(text, strlen(text), hash_string(text));
+    }
+
+    Atom intern(const StaticName &name) {
+        return _intern(name.name, name.size, name.hash);
+    }
+
+    Atom intern(const managed_string &text) {
+        return _intern(text.c_str(), text.size(), text.hash());
+    }
+
+    // kNoAtom when text has never been interned
+    Atom find(const char *text) const {
+        if (!text)
+            text = "";
+        return _find(text, strlen(text), hash_string(text));
+    }
+
+    Atom find(const StaticName &name) const {
+        return _find(name.name, name.size, name.hash);
+    }
+
+    // The string behind an atom ("" for unknown atoms)
+    const managed_string &name(Atom atom) const {
+        static const managed_string s_empty;
+        if (atom >= _names.count())
+            return s_empty;
+        return _names[atom];
+    }
+
+    size_t count() const { return _names.count(); }
+
+private:
+    Atom _intern(const char *text, size_t size, uint32_t hash) {
+        size_t slot = _probe(text, size, hash);
+        if (_slots[slot] != kNoAtom)
+            return _slots[slot];
+
+        if (_names.count() >= kNoAtom)
+            return kNoAtom; // Out of atoms
+
+        Atom atom = (Atom)_names.count();
+        _names.push(managed_string(text));
+        _hashes.push(hash);
+        _slots[slot] = atom;
+
+        // Keep the load under 3/4
+        if (_names.count() * 4 > _slots.count() * 3)
+            _rehash(_slots.count() * 2);
+        return atom;
+    }
+
+    Atom _find(const char *text, size_t size, uint32_t hash) const {
+        return _slots[_probe(text, size, hash)];
+    }
+
+    // Slot holding text, or the empty slot where it would go
+    size_t _probe(const char *text, size_t size, uint32_t hash) const {
+        size_t mask = _slots.count() - 1;
+        size_t slot = hash_mix(hash) & mask;
+        while (_slots[slot] != kNoAtom) {
+            Atom atom = _slots[slot];
+            if (_hashes[atom] == hash &&
+                _names[atom].size() == size &&
+                memcmp(_names[atom].c_str(), text, size) == 0)
+                return slot;
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    void _rehash(size_t capacity) {
+        _slots = Vec<Atom>(capacity);
+        _clear_slots();
+
+        size_t mask = capacity - 1;
+        for (size_t atom = 0; atom < _names.count(); atom++) {
+            size_t slot = hash_mix(_hashes[atom]) & mask;
+            while (_slots[slot] != kNoAtom)
+                slot = (slot + 1) & mask;
+            _slots[slot] = (Atom)atom;
+        }
+    }
+
+    void _clear_slots() {
+        for (size_t i = 0; i < _slots.count(); i++)
+            _slots[i] = kNoAtom;
+    }
+
+    Vec<managed_string> _names; // Indexed by atom
+    Vec<uint32_t> _hashes;      // Indexed by atom
+    Vec<Atom> _slots;           // Power of two
+};
+
+
+/*
+    Anything that names an atom: text, a StaticName, a managed_string
+    or an atom we already have. Lets APIs take all of them through a
+    single parameter.
+*/
+class AtomKey {
+public:
+    AtomKey(const char *text)
+        : _text(text)
+        , _static(nullptr)
+        , _string(nullptr)
+        , _atom(kNoAtom)
+    {}
+
+    AtomKey(const StaticName &name)
+        : _text(nullptr)
+        , _static(&name)
+        , _string(nullptr)
+        , _atom(kNoAtom)
+    {}
+
+    AtomKey(const managed_string &text)
+        : _text(nullptr)
+        , _static(nullptr)
+        , _string(&text)
+        , _atom(kNoAtom)
+    {}
+
+    AtomKey(Atom atom)
+        : _text(nullptr)
+        , _static(nullptr)
+        , _string(nullptr)
+        , _atom(atom)
+    {}
+
+    Atom intern(StringInterner &interner = StringInterner::global()) const {
+        if (_static)
+            return interner.intern(*_static);
+        if (_string)
+            return interner.intern(*_string);
+        if (_text)
+            return interner.intern(_text);
+        return _atom;
+    }
+
+private:
+    const char *_text;
+    const StaticName *_static;
+    const managed_string *_string;
+    Atom _atom;
+};
+
+}
@@ -1,5 +1,8 @@
 #pragma once
 #include "lutil.h"
+#include "lu_memory/utility.h"
+#include "lu_storage/growth.h"
+#include "lu_storage/vector.h"
 
 #define DEFAULT_SIZE 5
 
@@ -10,59 +13,119 @@ namespace lutil {
     as other models but very light on the compilation side
 
     - VALUE needs a default constructor
+
+    Keys and values share a single allocation (keys first, then
+    values) and only the live entries are ever constructed. Growth is
+    geometric by default, see set_growth().
+
+    The block comes from A's allocate_bytes()/deallocate_bytes() so
+    any allocator from lu_memory/allocators.h works here too.
 */
-template<typename KEY, typename VALUE>
+template<typename KEY, typename VALUE, typename A = Alloc<uint8_t>>
 class Map {
 public:
-    explicit Map(size_t size) {
-        _count = size;
-        _size = _count;
+    explicit Map(size_t size, const A &alloc = A())
+        : _alloc(alloc)
+    {
+        _count = 0;
+        _growth = GrowthPolicy::geometric();
+        _allocate(size);
 
-        _keys = new KEY[_size];
-        _values = new VALUE[_size];
+        for (; _count < _size; _count++) {
+            construct_at<KEY>(_keys + _count);
+            construct_at<VALUE>(_values + _count);
+        }
     }
 
     Map() {
         _count = 0;
-        _size = DEFAULT_SIZE;
+        _growth = GrowthPolicy::geometric();
+        _allocate(DEFAULT_SIZE);
+    }
 
-        _keys = new KEY[_size];
-        _values = new VALUE[_size];
+    explicit Map(const A &alloc)
+        : _alloc(alloc)
+    {
+        _count = 0;
+        _growth = GrowthPolicy::geometric();
+        _allocate(DEFAULT_SIZE);
     }
 
     ~Map() {
-        delete [] _keys;
-        delete [] _values;
+        _release();
     }
 
-    Map(const Map<KEY, VALUE> &other)
+    Map(const Map &other)
+        : _count(0)
+        , _growth(other._growth)
+        , _alloc(other._alloc)
+    {
+        _allocate(other._size);
+        _from_other(other);
+    }
+
+    Map(Map &&other)
         : _size(other._size)
         , _count(other._count)
+        , _growth(other._growth)
+        , _block(other._block)
+        , _keys(other._keys)
+        , _values(other._values)
+        , _alloc(lutil::move(other._alloc))
     {
-        _from_other(other);
+        other._size = 0;
+        other._count = 0;
+        other._block = nullptr;
+        other._keys = nullptr;
+        other._values = nullptr;
     }
 
-    Map &operator= (const Map<KEY, VALUE> &other) {
-        _count = other._count;
-        _size = other._size;
+    Map &operator= (const Map &other) {
+        if (this == &other)
+            return *this;
+
+        _release();
+        _count = 0;
+        _growth = other._growth;
+        _allocate(other._size);
         _from_other(other);
         return *this;
     }
 
+    Map &operator= (Map &&other) {
+        swap_val<size_t>(_size, other._size);
+        swap_val<size_t>(_count, other._count);
+        swap_val<GrowthPolicy>(_growth, other._growth);
+        swap_ptr(&_block, &other._block);
+        swap_ptr(&_keys, &other._keys);
+        swap_ptr(&_values, &other._values);
+        swap_val<A>(_alloc, other._alloc);
+        return *this;
+    }
+
+    /*
+        A miss inserts a default VALUE. When that fails (fixed growth,
+        no room left) you get a scratch value of this map's own that
+        is reset on every such miss and never stored. insert() is the
+        way to find out.
+    */
     VALUE &operator[](KEY key) {
         for (size_t i = 0; i < _count; i++) {
             if (_keys[i] == key) {
                 return _values[i];
             }
         }
-        auto v = VALUE();
-        insert(key, v); // EMPTY MAP MIGHT EXPLODE WHEN DESTROYED __START_HERE__
-        return _values[_count - 1]; // ?!?
+        if (!insert(key, VALUE())) {
+            _overflow = VALUE();
+            return _overflow;
+        }
+        return _values[_count - 1];
     }
 
     const VALUE &operator[](const KEY &key) const {
         // We should obviously make this a hash but I'm
         // not in the mood for the extra math atm.
+        // (see HashMap)
         for (size_t i = 0; i < _count; i++) {
             if (_keys[i] == key) {
                 return _values[i];
@@ -73,20 +136,34 @@ public:
     }
 
     size_t count() const { return _count; }
+    size_t capacity() const { return _size; }
 
-    void insert(KEY key, const VALUE &value) {
+    const GrowthPolicy &growth() const { return _growth; }
+    void set_growth(const GrowthPolicy &growth) { _growth = growth; }
+
+    /*
+        Insert or replace a value. Returns false only when we're full
+        and the growth policy won't let us resize.
+    */
+    bool insert(KEY key, const VALUE &value) {
         int idx = _index_of(key);
         if (idx < 0) {
             if (_size == _count) {
-                _expand(_size);
+                // value might live in our own storage
+                VALUE copy(value);
+                if (!_grow(_count + 1))
+                    return false;
+                _append(key, lutil::move(copy));
+            }
+            else {
+                _append(key, value);
             }
-            _keys[_count] = key;
-            _values[_count++] = value;
         }
         else {
             // replace an existing value
             _values[idx] = value;
         }
+        return true;
     }
 
     bool contains(KEY key) const {
@@ -102,6 +179,13 @@ public:
         _remove(index);
     }
 
+    // Make room for at least size entries (ignores the policy)
+    bool reserve(size_t size) {
+        if (size > _size)
+            return _reallocate(size);
+        return true;
+    }
+
 
     KEY key_from_value(VALUE val) const {
         for (size_t i = 0; i < _count; i++) {
@@ -118,7 +202,7 @@ public:
 
     class Iterator {
     public:
-        Iterator(Map<KEY, VALUE> *map, int index = 0)
+        Iterator(Map *map, int index = 0)
             : _map(map)
             , _index(index)
         {}
@@ -166,7 +250,7 @@ public:
         }
 
     private:
-        Map<KEY, VALUE> *_map;
+        Map *_map;
         size_t _index;
     };
 
@@ -180,26 +264,102 @@ public:
 
 
 private:
-    void _expand(size_t size) {
-        auto new_size = _size + size;
+    // Values sit right after the keys, padded out to their alignment
+    static size_t _values_offset(size_t size) {
+        size_t offset = size * sizeof(KEY);
+        size_t align = alignof(VALUE);
+        return (offset + align - 1) & ~(align - 1);
+    }
 
-        KEY *new_keys = new KEY[new_size];
-        VALUE *new_values = new VALUE[new_size];
+    static size_t _block_size(size_t size) {
+        return _values_offset(size) + size * sizeof(VALUE);
+    }
 
-        for (size_t i = 0; i < _count; i++)
-        {
-            new_keys[i] = _keys[i];
-            new_values[i] = _values[i];
+    static size_t _block_align() {
+        return (alignof(KEY) > alignof(VALUE)) ? alignof(KEY) : alignof(VALUE);
+    }
+
+    bool _allocate(size_t size) {
+        uint8_t *block = (uint8_t *)_alloc.allocate_bytes(
+            _block_size(size), _block_align()
+        );
+        if (!block && size > 0) {
+            // Allocator is out of room. Leave an empty map behind.
+            _block = nullptr;
+            _keys = nullptr;
+            _values = nullptr;
+            _size = 0;
+            return false;
+        }
+
+        _block = block;
+        _keys = reinterpret_cast<KEY *>(_block);
+        _values = reinterpret_cast<VALUE *>(_block + _values_offset(size));
+        _size = size;
+        return true;
+    }
+
+    void _release() {
+        for (size_t i = 0; i < _count; i++) {
+            destroy_at(_keys + i);
+            destroy_at(_values + i);
+        }
+        if (_block)
+            _alloc.deallocate_bytes(_block, _block_size(_size));
+        _block = nullptr;
+    }
+
+    bool _grow(size_t needed) {
+        size_t size = _growth.next(_size, needed);
+        if (size == 0)
+            return false;
+
+        return _reallocate(size);
+    }
+
+    bool _reallocate(size_t size) {
+        uint8_t *old_block = _block;
+        KEY *old_keys = _keys;
+        VALUE *old_values = _values;
+        size_t old_size = _size;
+
+        if (!_allocate(size)) {
+            _block = old_block;
+            _keys = old_keys;
+            _values = old_values;
+            _size = old_size;
+            return false;
         }
-        // ::memcpy(new_keys, _keys, _size);
-        // delete [] _keys;
-        
-        // ::memcpy(new_values, _values, _size);
-        // delete [] _values;
 
-        _keys = new_keys;
-        _values = new_values;
-        _size = new_size;
+        _relocate(_keys, old_keys, _count,
+                  bool_tag<is_trivially_copyable<KEY>::value>());
+        _relocate(_values, old_values, _count,
+                  bool_tag<is_trivially_copyable<VALUE>::value>());
+
+        if (old_block)
+            _alloc.deallocate_bytes(old_block, _block_size(old_size));
+        return true;
+    }
+
+    template<typename T>
+    static void _relocate(T *dest, T *source, size_t count, bool_tag<true>) {
+        if (count > 0)
+            memcpy((void *)dest, (const void *)source, count * sizeof(T));
+    }
+
+    template<typename T>
+    static void _relocate(T *dest, T *source, size_t count, bool_tag<false>) {
+        for (size_t i = 0; i < count; i++) {
+            construct_at<T>(dest + i, lutil::move(source[i]));
+            destroy_at(source + i);
+        }
+    }
+
+    template<typename V>
+    void _append(const KEY &key, V &&value) {
+        construct_at<KEY>(_keys + _count, key);
+        construct_at<VALUE>(_values + _count, lutil::forward<V>(value));
+        _count++;
     }
 
     int _index_of(KEY key) const {
@@ -214,32 +374,31 @@ private:
     void _remove(size_t index) {
         for (size_t i = index; i < _count - 1; i++)
         {
-            _keys[i] = _keys[i + 1];
-            _values[i] = _values[i + 1];
+            _keys[i] = lutil::move(_keys[i + 1]);
+            _values[i] = lutil::move(_values[i + 1]);
         }
-        _keys[_count - 1] = KEY();
-        _values[_count - 1] = VALUE();
         _count--;
+        destroy_at(_keys + _count);
+        destroy_at(_values + _count);
     }
 
-    void _from_other(const Map<KEY, VALUE> &other) {
-        _size = other._size;
-        _count = other._count;
-        _keys = new KEY[_size];
-        _values = new VALUE[_size];
-
-        for (size_t i = 0; i < _count; i++)
-        {
-            _keys[i] = other._keys[i];
-            _values[i] = other._values[i];
-        }
+    // Expects freshly allocated (empty) storage
+    void _from_other(const Map &other) {
+        size_t count = (other._count < _size) ? other._count : _size;
+        for (size_t i = 0; i < count; i++)
+            _append(other._keys[i], other._values[i]);
     }
 
     size_t _size;
     size_t _count;
+    GrowthPolicy _growth;
 
+    uint8_t *_block;
     KEY *_keys;
     VALUE *_values;
+    A _alloc;
+
+    VALUE _overflow; // Handed out by operator[] when full
 };
 
 
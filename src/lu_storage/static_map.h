@@ -0,0 +1,203 @@
+#pragma once
+#include "lutil.h"
+#include "lu_memory/utility.h"
+
+namespace lutil {
+
+/*
+    Fixed capacity Map with inline, uninitialized storage. Keeps the
+    insertion order and the Iterator key()/value() interface of Map
+    without ever touching the heap.
+
+    - insert() returns false once all N entries are used
+    - operator[] on a full map hands back a scratch value of this
+      map's own, reset on every such miss and never stored
+*/
+template<typename KEY, typename VALUE, size_t N>
+class StaticMap {
+public:
+    StaticMap()
+        : _count(0)
+    {}
+
+    ~StaticMap() {
+        clear();
+    }
+
+    StaticMap(const StaticMap &other)
+        : _count(0)
+    {
+        _from_other(other);
+    }
+
+    StaticMap &operator= (const StaticMap &other) {
+        if (this == &other)
+            return *this;
+
+        clear();
+        _from_other(other);
+        return *this;
+    }
+
+    VALUE &operator[](const KEY &key) {
+        int idx = _index_of(key);
+        if (idx >= 0)
+            return _values()[idx];
+
+        if (!insert(key, VALUE())) {
+            _overflow = VALUE();
+            return _overflow;
+        }
+        return _values()[_count - 1];
+    }
+
+    size_t count() const { return _count; }
+    size_t capacity() const { return N; }
+
+    bool insert(const KEY &key, const VALUE &value) {
+        int idx = _index_of(key);
+        if (idx >= 0) {
+            // replace an existing value
+            _values()[idx] = value;
+            return true;
+        }
+
+        if (_count == N)
+            return false;
+
+        construct_at<KEY>(_keys() + _count, key);
+        construct_at<VALUE>(_values() + _count, value);
+        _count++;
+        return true;
+    }
+
+    bool contains(const KEY &key) const {
+        return (_index_of(key) >= 0);
+    }
+
+    void remove(const KEY &key) {
+        int index = _index_of(key);
+        if (index < 0)
+            return; // Don't have it
+
+        KEY *keys = _keys();
+        VALUE *values = _values();
+        for (size_t i = index; i < _count - 1; i++) {
+            keys[i] = lutil::move(keys[i + 1]);
+            values[i] = lutil::move(values[i + 1]);
+        }
+        _count--;
+        destroy_at(keys + _count);
+        destroy_at(values + _count);
+    }
+
+    void clear() {
+        for (size_t i = 0; i < _count; i++) {
+            destroy_at(_keys() + i);
+            destroy_at(_values() + i);
+        }
+        _count = 0;
+    }
+
+    KEY key_from_value(const VALUE &val) const {
+        for (size_t i = 0; i < _count; i++) {
+            if (_values()[i] == val) {
+                return _keys()[i];
+            }
+        }
+        return KEY();
+    }
+
+    // ----------------------------------------------------------------
+    // ITERATION
+
+    class Iterator {
+    public:
+        Iterator(StaticMap *map, int index = 0)
+            : _map(map)
+            , _index(index)
+        {}
+
+        Iterator(const Iterator &it)
+            : _map(it._map)
+            , _index(it._index)
+        {}
+
+        KEY &key() {
+            return _map->_keys()[_index];
+        }
+
+        VALUE &value() {
+            return _map->_values()[_index];
+        }
+
+        Iterator &operator++ () {
+            _index++;
+            return *this;
+        }
+
+        Iterator operator++ (int) {
+            Iterator output(*this);
+            ++(*this);
+            return output;
+        }
+
+        bool has_next() const {
+            return _index < _map->_count;
+        }
+
+        bool operator== (const Iterator &other) const {
+            return (this->_map == other._map &&
+                    this->_index == other._index);
+        }
+
+        bool operator!= (const Iterator &other) const {
+            return (this->_map != other._map ||
+                    this->_index != other._index);
+        }
+
+    private:
+        StaticMap *_map;
+        size_t _index;
+    };
+
+    Iterator begin() {
+        return Iterator(this);
+    }
+
+    Iterator end() {
+        return Iterator(this, (int)_count);
+    }
+
+private:
+    KEY *_keys() { return reinterpret_cast<KEY *>(_key_storage); }
+    const KEY *_keys() const { return reinterpret_cast<const KEY *>(_key_storage); }
+
+    VALUE *_values() { return reinterpret_cast<VALUE *>(_value_storage); }
+    const VALUE *_values() const { return reinterpret_cast<const VALUE *>(_value_storage); }
+
+    int _index_of(const KEY &key) const {
+        for (int i = 0; i < (int)_count; i++) {
+            if (_keys()[i] == key) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    void _from_other(const StaticMap &other) {
+        for (size_t i = 0; i < other._count; i++) {
+            construct_at<KEY>(_keys() + i, other._keys()[i]);
+            construct_at<VALUE>(_values() + i, other._values()[i]);
+        }
+        _count = other._count;
+    }
+
+    size_t _count;
+    alignas(KEY) uint8_t _key_storage[N * sizeof(KEY)];
+    alignas(VALUE) uint8_t _value_storage[N * sizeof(VALUE)];
+
+    VALUE _overflow; // Handed out by operator[] when full
+};
+
+}
@@ -0,0 +1,189 @@
+#pragma once
+#include "lutil.h"
+#include "lu_memory/utility.h"
+
+namespace lutil {
+
+/*
+    Fixed capacity vector that keeps its elements inline. Nothing is
+    ever heap allocated and only live elements are constructed, so
+    unused slots cost nothing but their bytes.
+
+    Same interface as Vec - push() simply returns false once all N
+    slots are taken.
+
+    .. code-block:: cpp
+
+        lutil::StaticVec<float, 8> samples;
+        samples.push(1.0);
+*/
+template<typename T, size_t N>
+class StaticVec {
+public:
+    StaticVec()
+        : _count(0)
+    {}
+
+    ~StaticVec() {
+        clear();
+    }
+
+    StaticVec(const StaticVec &other)
+        : _count(0)
+    {
+        for (size_t i = 0; i < other._count; i++)
+            push(other[i]);
+    }
+
+    StaticVec &operator= (const StaticVec &other) {
+        if (this == &other)
+            return *this;
+
+        clear();
+        for (size_t i = 0; i < other._count; i++)
+            push(other[i]);
+        return *this;
+    }
+
+    T &operator[](size_t index) {
+        return _data()[index];
+    }
+
+    const T &operator[](size_t index) const {
+        return _data()[index];
+    }
+
+    size_t count() const { return _count; }
+    size_t capacity() const { return N; }
+
+    // Capacity is fixed, here to keep the Vec interface
+    void reserve(size_t) {}
+
+    bool push(const T& element) {
+        if (_count == N)
+            return false;
+        construct_at<T>(_data() + _count, element);
+        _count++;
+        return true;
+    }
+
+    bool push(T&& element) {
+        if (_count == N)
+            return false;
+        construct_at<T>(_data() + _count, lutil::move(element));
+        _count++;
+        return true;
+    }
+
+    template<typename... Args>
+    bool emplace(Args&&... args) {
+        if (_count == N)
+            return false;
+        construct_at<T>(_data() + _count, lutil::forward<Args>(args)...);
+        _count++;
+        return true;
+    }
+
+    T pop(int index) {
+        if (index < 0) {
+            index = (int)_count + index;
+        }
+        if (index < 0 || index >= (int)_count) {
+            return T(); // Exception?
+        }
+
+        T *data = _data();
+        T val = lutil::move(data[index]);
+        for (size_t i = index; i < _count - 1; i++)
+            data[i] = lutil::move(data[i + 1]);
+
+        _count--;
+        destroy_at(data + _count);
+        return val;
+    }
+
+    bool contains(const T &element) const {
+        for (size_t i = 0; i < _count; ++i) {
+            if (element == _data()[i])
+                return true;
+        }
+        return false;
+    }
+
+    void clear() {
+        for (size_t i = 0; i < _count; i++)
+            destroy_at(_data() + i);
+        _count = 0;
+    }
+
+    // ----------------------------------------------------------------
+    // ITERATION
+
+    class Iterator {
+    public:
+        Iterator(StaticVec *vec, int index = 0)
+            : _vec(vec)
+            , _index(index)
+        {}
+
+        Iterator(const Iterator &it)
+            : _vec(it._vec)
+            , _index(it._index)
+        {}
+
+        T &operator* () {
+            return (*_vec)[_index];
+        }
+
+        Iterator &operator++ () {
+            _index++;
+            return *this;
+        }
+
+        Iterator operator++ (int) {
+            Iterator output(*this);
+            ++(*this);
+            return output;
+        }
+
+        bool has_next() const {
+            return _index < _vec->_count;
+        }
+
+        bool operator== (const Iterator &other) const {
+            return (this->_vec == other._vec &&
+                    this->_index == other._index);
+        }
+
+        bool operator!= (const Iterator &other) const {
+            return (this->_vec != other._vec ||
+                    this->_index != other._index);
+        }
+
+    private:
+        StaticVec *_vec;
+        size_t _index;
+    };
+
+    Iterator begin() {
+        return Iterator(this);
+    }
+
+    Iterator end() {
+        return Iterator(this, (int)_count);
+    }
+
+private:
+    T *_data() {
+        return reinterpret_cast<T *>(_storage);
+    }
+
+    const T *_data() const {
+        return reinterpret_cast<const T *>(_storage);
+    }
+
+    size_t _count;
+    alignas(T) uint8_t _storage[N * sizeof(T)];
+};
+
+}
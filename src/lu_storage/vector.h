@@ -1,12 +1,19 @@
 #pragma once
 #include "lutil.h"
 #include "lu_memory/managed_ptr.h"
+#include "lu_memory/utility.h"
+#include "lu_storage/growth.h"
 
 #define DEFAULT_SIZE 5
 
 namespace lutil {
 
 /*
+    Default allocator - plain new[]/delete[]. See lu_memory/allocators.h
+    for arena, pool and stack backed alternatives.
+
+    - allocate() hands back size constructed elements (or nullptr)
+    - the *_bytes() pair gives raw, max aligned storage (used by Map)
 */
 template<typename T>
 class Alloc {
@@ -17,57 +24,126 @@ public:
         return new T[size];
     }
 
-    void deallocate(T *data) {
+    void deallocate(T *data, size_t /*size*/ = 0) {
         delete[] data;
     }
 
-    void copy(T *dest, T *source, size_t size) {
+    void *allocate_bytes(size_t size, size_t /*align*/) {
+        return new uint8_t[size];
+    }
+
+    void deallocate_bytes(void *data, size_t /*size*/) {
+        delete[] (uint8_t *)data;
+    }
+
+    void copy(T *dest, const T *source, size_t size) {
         for (size_t i = 0; i < size; i++)
             *(dest + i) = *(source + i);
     }
 
+    /*
+        Relocate elements into fresh storage. Trivial types get a
+        single memcpy, everything else is move assigned so owning
+        types (managed_ptr, Vec, ...) skip the copy/release churn.
+    */
+    void move(T *dest, T *source, size_t size) {
+        _move(dest, source, size, bool_tag<is_trivially_copyable<T>::value>());
+    }
+
     void remove(T *elements, size_t index, size_t count) {
         for (size_t i = index; i < count - 1; i++)
-            elements[i] = elements[i + 1];
+            elements[i] = lutil::move(elements[i + 1]);
         elements[count - 1] = T(); // Nuke the last element
     }
+
+private:
+    void _move(T *dest, T *source, size_t size, bool_tag<true>) {
+        if (size > 0)
+            memcpy((void *)dest, (const void *)source, size * sizeof(T));
+    }
+
+    void _move(T *dest, T *source, size_t size, bool_tag<false>) {
+        for (size_t i = 0; i < size; i++)
+            dest[i] = lutil::move(source[i]);
+    }
 };
 
-/* _Very_ lightweight vector template */
+/*
+    _Very_ lightweight vector template
+
+    Growth is geometric (doubling) by default. Use set_growth() to
+    pick a different GrowthPolicy per instance, e.g. a fixed step or
+    a fixed capacity that never reallocates after reserve().
+*/
 template<typename T, typename A = Alloc<T>>
 class Vec {
 public:
-    explicit Vec(size_t size) {
-        _count = size;
-        _size = _count;
-
-        _elements = _alloc.allocate(_size);
-        reset();
+    explicit Vec(size_t size, const A &alloc = A())
+        : _alloc(alloc)
+    {
+        _init(size, size);
     }
 
     Vec() {
-        _count = 0;
-        _size = DEFAULT_SIZE;
+        _init(DEFAULT_SIZE, 0);
+    }
 
-        _elements = _alloc.allocate(_size);
-        reset();
+    explicit Vec(const A &alloc)
+        : _alloc(alloc)
+    {
+        _init(DEFAULT_SIZE, 0);
     }
 
     ~Vec() {
-        _alloc.deallocate(_elements);
+        _alloc.deallocate(_elements, _size);
+    }
+
+    Vec(const Vec &other)
+        : _size(other._size)
+        , _count(other._count)
+        , _growth(other._growth)
+        , _alloc(other._alloc)
+    {
+        _elements = _alloc.allocate(_size);
+        if (!_elements) {
+            _size = 0;
+            _count = 0;
+        }
+        _alloc.copy(_elements, other._elements, _count);
     }
 
-    Vec(const Vec<T> &other)
+    Vec(Vec &&other)
         : _size(other._size)
         , _count(other._count)
+        , _growth(other._growth)
+        , _elements(other._elements)
+        , _alloc(lutil::move(other._alloc))
     {
-        _from_other(other);
+        other._elements = nullptr;
+        other._size = 0;
+        other._count = 0;
     }
 
-    Vec &operator= (const Vec<T> &other) {
+    Vec &operator= (const Vec &other) {
+        if (this == &other)
+            return *this;
+
+        T *elements = _alloc.allocate(other._size);
+        if (!elements)
+            return *this; // Out of memory, keep what we have
+
+        _alloc.copy(elements, other._elements, other._count);
+        _alloc.deallocate(_elements, _size);
+
+        _elements = elements;
         _count = other._count;
         _size = other._size;
-        _from_other(other);
+        _growth = other._growth;
+        return *this;
+    }
+
+    Vec &operator= (Vec &&other) {
+        swap(other);
         return *this;
     }
 
@@ -86,19 +162,60 @@ public:
     }
 
     size_t count() const { return _count; }
+    size_t capacity() const { return _size; }
+
+    const GrowthPolicy &growth() const { return _growth; }
+    void set_growth(const GrowthPolicy &growth) { _growth = growth; }
 
-    void push(const T& element) {
+    /*
+        Push the element to the back. Returns false only if we're at
+        capacity and the growth policy doesn't allow a resize.
+    */
+    bool push(const T& element) {
         if (_size == _count) {
-            _expand(_size);
+            // element might live in our own storage
+            T value(element);
+            if (!_grow(_count + 1))
+                return false;
+            _elements[_count++] = lutil::move(value);
+            return true;
         }
         _elements[_count++] = element;
+        return true;
     }
 
-    void push(T&& element) {
-        if (_size == _count) {
-            _expand(_size);
+    bool push(T&& element) {
+        if (_size == _count && !_grow(_count + 1)) {
+            return false;
         }
-        _elements[_count++] = element;
+        _elements[_count++] = lutil::move(element);
+        return true;
+    }
+
+    /*
+        Build a T from args at the back. Slots are always constructed
+        so the new value is move assigned into place.
+    */
+    template<typename... Args>
+    bool emplace(Args&&... args) {
+        if (_size == _count && !_grow(_count + 1)) {
+            return false;
+        }
+        _elements[_count++] = T(lutil::forward<Args>(args)...);
+        return true;
+    }
+
+    // Make room for at least size elements (ignores the policy)
+    bool reserve(size_t size) {
+        if (size > _size)
+            return _reallocate(size);
+        return true;
+    }
+
+    // Drop any spare capacity
+    void shrink_to_fit() {
+        if (_size > _count)
+            _reallocate(_count);
     }
 
     T pop(int index) {
@@ -109,7 +226,7 @@ public:
             return T(); // Exception?
         }
 
-        T val = _elements[index];
+        T val = lutil::move(_elements[index]);
         _remove(index);
         return val;
     }
@@ -122,11 +239,13 @@ public:
         return false;
     }
 
-    void swap(Vec<T> &other)
+    void swap(Vec &other)
     {
         swap_ptr(&_elements, &other._elements);
         swap_val<size_t>(_size, other._size);
         swap_val<size_t>(_count, other._count);
+        swap_val<GrowthPolicy>(_growth, other._growth);
+        swap_val<A>(_alloc, other._alloc);
     }
 
     // ----------------------------------------------------------------
@@ -134,7 +253,7 @@ public:
 
     class Iterator {
     public:
-        Iterator(Vec<T> *vec, int index = 0)
+        Iterator(Vec *vec, int index = 0)
             : _vec(vec)
             , _index(index)
         {}
@@ -178,7 +297,7 @@ public:
         }
 
     private:
-        Vec<T> *_vec;
+        Vec *_vec;
         size_t _index;
     };
 
@@ -191,17 +310,34 @@ public:
     }
 
 private:
-    void _expand(size_t size) {
-        auto new_size = _size + size;
+    void _init(size_t size, size_t count) {
+        _growth = GrowthPolicy::geometric();
+        _elements = _alloc.allocate(size);
+        _size = _elements ? size : 0;
+        _count = _elements ? count : 0;
+        reset();
+    }
+
+    bool _grow(size_t needed) {
+        size_t size = _growth.next(_size, needed);
+        if (size == 0)
+            return false;
+
+        return _reallocate(size);
+    }
 
-        T *new_elements = _alloc.allocate(new_size);
+    bool _reallocate(size_t size) {
+        T *new_elements = _alloc.allocate(size);
+        if (!new_elements)
+            return false; // Allocator is out of room
 
-        // Copy from one to the other
-        _alloc.copy(new_elements, _elements, _size);
-        _alloc.deallocate(_elements);
+        // Move from one to the other
+        _alloc.move(new_elements, _elements, _count);
+        _alloc.deallocate(_elements, _size);
 
         _elements = new_elements;
-        _size = new_size;
+        _size = size;
+        return true;
     }
 
     void _remove(size_t index) {
@@ -209,13 +345,9 @@ private:
         _count--;
     }
 
-    void _from_other(const Vec<T> &other) {
-        _elements = _alloc.allocate(_size);
-        _alloc.copy(_elements, other._elements, _size);
-    }
-
     size_t _size;  // Size in mem
     size_t _count; // Number of elements
+    GrowthPolicy _growth;
 
     T *_elements;
     A _alloc;
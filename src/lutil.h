@@ -18,6 +18,9 @@
 #include <cmath>
 #include <cstring>
 #include <stdint.h>
+#ifndef LUTIL_NO_HOST_SHIM
+#include "lu_host/arduino.h"
+#endif
 #ifdef WIN32
 #undef LUTIL_API
 #ifdef LUTIL_IMPORT
@@ -30,4 +33,23 @@
 #endif
 #endif
 
+/*
+    Zero-heap builds. Uncomment (or pass -DLUTIL_STATIC_STORAGE) to
+    keep the Processor and Processable tables in fixed, inline
+    storage. The limits below size those tables.
+*/
+// #define LUTIL_STATIC_STORAGE
+
+#ifdef LUTIL_STATIC_STORAGE
+#ifndef LUTIL_MAX_PROCESSABLES
+#define LUTIL_MAX_PROCESSABLES 16 // Processables per Processor
+#endif
+#ifndef LUTIL_MAX_TRIGGERS
+#define LUTIL_MAX_TRIGGERS 4      // Triggers per Processable (values 0 to N-1)
+#endif
+#ifndef LUTIL_MAX_CALLBACKS
+#define LUTIL_MAX_CALLBACKS 2     // Callbacks per trigger, on average
+#endif
+#endif
+
 namespace lutil {}